@@ -8,16 +8,24 @@ TARGET = $$TOP_DIR/lib/$$MALIIT_CONNECTION_LIB
 
 include($$TOP_DIR/common/libmaliit-common.pri)
 
-CONFIG += staticlib
+CONFIG += staticlib c++14
 
 # Interface classes
 PUBLIC_HEADERS += \
     connectionfactory.h \
     minputcontextconnection.h \
+    mimwidgetstate.h \
 
 PUBLIC_SOURCES += \
     connectionfactory.cpp \
     minputcontextconnection.cpp \
+    mimwidgetstate.cpp \
+
+PRIVATE_HEADERS += \
+    utf8offsetindex.h \
+
+PRIVATE_SOURCES += \
+    utf8offsetindex.cpp \
 
 wayland {
     QT += gui-private
@@ -0,0 +1,463 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "mimwidgetstate.h"
+
+#include <QHash>
+
+namespace {
+    // attribute names, indexed by MImWidgetState::Field
+    const char * const FieldNames[MImWidgetState::FieldCount] = {
+        "focusState",
+        "contentType",
+        "enterKeyType",
+        "correctionEnabled",
+        "predictionEnabled",
+        "autocapitalizationEnabled",
+        "surroundingText",
+        "anchorPosition",
+        "cursorPosition",
+        "hasSelection",
+        "inputMethodMode",
+        "toolbarId",
+        "toolbar",
+        "winId",
+        "cursorRectangle",
+        "hiddenText",
+        "preeditClickPos",
+        "maxTextLength",
+        "platformData",
+        0
+    };
+
+    QHash<QString, MImWidgetState::Field> createFieldIndex()
+    {
+        QHash<QString, MImWidgetState::Field> index;
+        for (int field = 0; field < MImWidgetState::OtherAttributesField; ++field) {
+            index.insert(QString::fromLatin1(FieldNames[field]), static_cast<MImWidgetState::Field>(field));
+        }
+        return index;
+    }
+
+    WId variantToWinId(const QVariant &winIdVariant)
+    {
+        // after transfer by dbus type can change
+        switch (winIdVariant.type()) {
+        case QVariant::UInt:
+            if (sizeof(uint) >= sizeof(WId))
+                return winIdVariant.toUInt();
+            break;
+        case QVariant::ULongLong:
+            if (sizeof(qulonglong) >= sizeof(WId))
+                return winIdVariant.toULongLong();
+            break;
+        default:
+            if (winIdVariant.canConvert<WId>())
+                return winIdVariant.value<WId>();
+        }
+        return 0;
+    }
+}
+
+MImWidgetState::MImWidgetState()
+    : m_validFields(0)
+    , m_focusState(false)
+    , m_contentType(0)
+    , m_enterKeyType(0)
+    , m_correctionEnabled(false)
+    , m_predictionEnabled(false)
+    , m_autoCapitalizationEnabled(false)
+    , m_surroundingText()
+    , m_anchorPosition(0)
+    , m_cursorPosition(0)
+    , m_hasSelection(false)
+    , m_inputMethodMode(0)
+    , m_toolbarId(0)
+    , m_toolbar()
+    , m_winId(0)
+    , m_cursorRectangle()
+    , m_hiddenText(false)
+    , m_preeditClickPos(0)
+    , m_maxTextLength(0)
+    , m_platformData()
+    , m_otherAttributes()
+{
+}
+
+MImWidgetState MImWidgetState::fromMap(const QMap<QString, QVariant> &map)
+{
+    MImWidgetState state;
+
+    for (QMap<QString, QVariant>::const_iterator it = map.constBegin(); it != map.constEnd(); ++it) {
+        const Field field = fieldForName(it.key());
+
+        if (field == OtherAttributesField) {
+            state.setOtherAttribute(it.key(), it.value());
+        } else {
+            state.setValue(field, it.value());
+        }
+    }
+
+    return state;
+}
+
+QMap<QString, QVariant> MImWidgetState::toMap() const
+{
+    QMap<QString, QVariant> map(m_otherAttributes);
+
+    for (int field = 0; field < OtherAttributesField; ++field) {
+        if (isValid(static_cast<Field>(field))) {
+            map.insert(QString::fromLatin1(FieldNames[field]), value(static_cast<Field>(field)));
+        }
+    }
+
+    return map;
+}
+
+const char *MImWidgetState::fieldName(Field field)
+{
+    if (field < 0 || field >= FieldCount) {
+        return 0;
+    }
+    return FieldNames[field];
+}
+
+MImWidgetState::Field MImWidgetState::fieldForName(const QString &name)
+{
+    static const QHash<QString, Field> index(createFieldIndex());
+
+    return index.value(name, OtherAttributesField);
+}
+
+MImWidgetState::Fields MImWidgetState::changedFields(const MImWidgetState &other) const
+{
+    Fields changed = m_validFields ^ other.m_validFields;
+    const Fields common = m_validFields & other.m_validFields;
+
+#define CHECK_FIELD(field, member) \
+    if ((common & fieldMask(field)) && member != other.member) \
+        changed |= fieldMask(field);
+
+    CHECK_FIELD(FocusStateField, m_focusState)
+    CHECK_FIELD(ContentTypeField, m_contentType)
+    CHECK_FIELD(EnterKeyTypeField, m_enterKeyType)
+    CHECK_FIELD(CorrectionField, m_correctionEnabled)
+    CHECK_FIELD(PredictionField, m_predictionEnabled)
+    CHECK_FIELD(AutoCapitalizationField, m_autoCapitalizationEnabled)
+    CHECK_FIELD(SurroundingTextField, m_surroundingText)
+    CHECK_FIELD(AnchorPositionField, m_anchorPosition)
+    CHECK_FIELD(CursorPositionField, m_cursorPosition)
+    CHECK_FIELD(HasSelectionField, m_hasSelection)
+    CHECK_FIELD(InputMethodModeField, m_inputMethodMode)
+    CHECK_FIELD(ToolbarIdField, m_toolbarId)
+    CHECK_FIELD(ToolbarField, m_toolbar)
+    CHECK_FIELD(WinIdField, m_winId)
+    CHECK_FIELD(CursorRectangleField, m_cursorRectangle)
+    CHECK_FIELD(HiddenTextField, m_hiddenText)
+    CHECK_FIELD(PreeditClickPosField, m_preeditClickPos)
+    CHECK_FIELD(MaxTextLengthField, m_maxTextLength)
+    CHECK_FIELD(PlatformDataField, m_platformData)
+    CHECK_FIELD(OtherAttributesField, m_otherAttributes)
+
+#undef CHECK_FIELD
+
+    return changed;
+}
+
+QVariant MImWidgetState::value(Field field) const
+{
+    if (!isValid(field)) {
+        return QVariant();
+    }
+
+    switch (field) {
+    case FocusStateField:
+        return m_focusState;
+    case ContentTypeField:
+        return m_contentType;
+    case EnterKeyTypeField:
+        return m_enterKeyType;
+    case CorrectionField:
+        return m_correctionEnabled;
+    case PredictionField:
+        return m_predictionEnabled;
+    case AutoCapitalizationField:
+        return m_autoCapitalizationEnabled;
+    case SurroundingTextField:
+        return m_surroundingText;
+    case AnchorPositionField:
+        return m_anchorPosition;
+    case CursorPositionField:
+        return m_cursorPosition;
+    case HasSelectionField:
+        return m_hasSelection;
+    case InputMethodModeField:
+        return m_inputMethodMode;
+    case ToolbarIdField:
+        return m_toolbarId;
+    case ToolbarField:
+        return m_toolbar;
+    case WinIdField:
+        return static_cast<qulonglong>(m_winId);
+    case CursorRectangleField:
+        return m_cursorRectangle;
+    case HiddenTextField:
+        return m_hiddenText;
+    case PreeditClickPosField:
+        return m_preeditClickPos;
+    case MaxTextLengthField:
+        return m_maxTextLength;
+    case PlatformDataField:
+        return m_platformData;
+    case OtherAttributesField:
+        return m_otherAttributes;
+    default:
+        return QVariant();
+    }
+}
+
+void MImWidgetState::setValue(Field field, const QVariant &value)
+{
+    if (!value.isValid()) {
+        unset(field);
+        return;
+    }
+
+    bool ok = true;
+    switch (field) {
+    case FocusStateField:
+        setFocusState(value.toBool());
+        break;
+    case ContentTypeField: {
+        const int contentType = value.toInt(&ok);
+        if (ok)
+            setContentType(contentType);
+        break;
+    }
+    case EnterKeyTypeField: {
+        const int enterKeyType = value.toInt(&ok);
+        if (ok)
+            setEnterKeyType(enterKeyType);
+        break;
+    }
+    case CorrectionField:
+        setCorrectionEnabled(value.toBool());
+        break;
+    case PredictionField:
+        setPredictionEnabled(value.toBool());
+        break;
+    case AutoCapitalizationField:
+        setAutoCapitalizationEnabled(value.toBool());
+        break;
+    case SurroundingTextField:
+        setSurroundingText(value.toString());
+        break;
+    case AnchorPositionField:
+        setAnchorPosition(value.toInt());
+        break;
+    case CursorPositionField:
+        setCursorPosition(value.toInt());
+        break;
+    case HasSelectionField:
+        setHasSelection(value.toBool());
+        break;
+    case InputMethodModeField: {
+        const int mode = value.toInt(&ok);
+        if (ok)
+            setInputMethodMode(mode);
+        break;
+    }
+    case ToolbarIdField:
+        setToolbarId(value.toInt());
+        break;
+    case ToolbarField:
+        setToolbar(value.toString());
+        break;
+    case WinIdField:
+        setWinId(variantToWinId(value));
+        break;
+    case CursorRectangleField:
+        setCursorRectangle(value.toRect());
+        break;
+    case HiddenTextField:
+        setHiddenText(value.toBool());
+        break;
+    case PreeditClickPosField:
+        setPreeditClickPos(value.toInt());
+        break;
+    case MaxTextLengthField:
+        setMaxTextLength(value.toInt());
+        break;
+    case PlatformDataField:
+        setPlatformData(value.toString());
+        break;
+    case OtherAttributesField:
+        m_otherAttributes = value.toMap();
+        m_validFields |= fieldMask(OtherAttributesField);
+        break;
+    default:
+        ok = false;
+        break;
+    }
+
+    if (!ok) {
+        unset(field);
+    }
+}
+
+void MImWidgetState::unset(Field field)
+{
+    if (field == OtherAttributesField) {
+        m_otherAttributes.clear();
+    }
+    m_validFields &= ~fieldMask(field);
+}
+
+void MImWidgetState::clear()
+{
+    *this = MImWidgetState();
+}
+
+void MImWidgetState::setFocusState(bool focusState)
+{
+    m_focusState = focusState;
+    m_validFields |= fieldMask(FocusStateField);
+}
+
+void MImWidgetState::setContentType(int contentType)
+{
+    m_contentType = contentType;
+    m_validFields |= fieldMask(ContentTypeField);
+}
+
+void MImWidgetState::setEnterKeyType(int enterKeyType)
+{
+    m_enterKeyType = enterKeyType;
+    m_validFields |= fieldMask(EnterKeyTypeField);
+}
+
+void MImWidgetState::setCorrectionEnabled(bool enabled)
+{
+    m_correctionEnabled = enabled;
+    m_validFields |= fieldMask(CorrectionField);
+}
+
+void MImWidgetState::setPredictionEnabled(bool enabled)
+{
+    m_predictionEnabled = enabled;
+    m_validFields |= fieldMask(PredictionField);
+}
+
+void MImWidgetState::setAutoCapitalizationEnabled(bool enabled)
+{
+    m_autoCapitalizationEnabled = enabled;
+    m_validFields |= fieldMask(AutoCapitalizationField);
+}
+
+void MImWidgetState::setSurroundingText(const QString &text)
+{
+    m_surroundingText = text;
+    m_validFields |= fieldMask(SurroundingTextField);
+}
+
+void MImWidgetState::setAnchorPosition(int position)
+{
+    m_anchorPosition = position;
+    m_validFields |= fieldMask(AnchorPositionField);
+}
+
+void MImWidgetState::setCursorPosition(int position)
+{
+    m_cursorPosition = position;
+    m_validFields |= fieldMask(CursorPositionField);
+}
+
+void MImWidgetState::setHasSelection(bool hasSelection)
+{
+    m_hasSelection = hasSelection;
+    m_validFields |= fieldMask(HasSelectionField);
+}
+
+void MImWidgetState::setInputMethodMode(int mode)
+{
+    m_inputMethodMode = mode;
+    m_validFields |= fieldMask(InputMethodModeField);
+}
+
+void MImWidgetState::setToolbarId(int id)
+{
+    m_toolbarId = id;
+    m_validFields |= fieldMask(ToolbarIdField);
+}
+
+void MImWidgetState::setToolbar(const QString &toolbar)
+{
+    m_toolbar = toolbar;
+    m_validFields |= fieldMask(ToolbarField);
+}
+
+void MImWidgetState::setWinId(WId id)
+{
+    m_winId = id;
+    m_validFields |= fieldMask(WinIdField);
+}
+
+void MImWidgetState::setCursorRectangle(const QRect &rectangle)
+{
+    m_cursorRectangle = rectangle;
+    m_validFields |= fieldMask(CursorRectangleField);
+}
+
+void MImWidgetState::setHiddenText(bool hidden)
+{
+    m_hiddenText = hidden;
+    m_validFields |= fieldMask(HiddenTextField);
+}
+
+void MImWidgetState::setPreeditClickPos(int position)
+{
+    m_preeditClickPos = position;
+    m_validFields |= fieldMask(PreeditClickPosField);
+}
+
+void MImWidgetState::setMaxTextLength(int length)
+{
+    m_maxTextLength = length;
+    m_validFields |= fieldMask(MaxTextLengthField);
+}
+
+void MImWidgetState::setPlatformData(const QString &data)
+{
+    m_platformData = data;
+    m_validFields |= fieldMask(PlatformDataField);
+}
+
+void MImWidgetState::setOtherAttribute(const QString &name, const QVariant &value)
+{
+    if (value.isValid()) {
+        m_otherAttributes.insert(name, value);
+    } else {
+        m_otherAttributes.remove(name);
+    }
+
+    if (m_otherAttributes.isEmpty()) {
+        m_validFields &= ~fieldMask(OtherAttributesField);
+    } else {
+        m_validFields |= fieldMask(OtherAttributesField);
+    }
+}
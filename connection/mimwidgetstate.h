@@ -0,0 +1,170 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMWIDGETSTATE_H
+#define MIMWIDGETSTATE_H
+
+#include <QMap>
+#include <QMetaType>
+#include <QRect>
+#include <QString>
+#include <QVariant>
+#include <QWindow>
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief State of the focused input widget.
+ *
+ * Holds the well known widget attributes in typed members, each with a
+ * validity bit, so reading the state needs no string keyed lookups.
+ * Attributes without a field are kept as they are and only show up in the
+ * map view. toMap() and fromMap() convert from and to the attribute map
+ * used by the widgetStateChanged() signal and MImUpdateEvent.
+ */
+class MImWidgetState
+{
+public:
+    enum Field {
+        FocusStateField,
+        ContentTypeField,
+        EnterKeyTypeField,
+        CorrectionField,
+        PredictionField,
+        AutoCapitalizationField,
+        SurroundingTextField,
+        AnchorPositionField,
+        CursorPositionField,
+        HasSelectionField,
+        InputMethodModeField,
+        ToolbarIdField,
+        ToolbarField,
+        WinIdField,
+        CursorRectangleField,
+        HiddenTextField,
+        PreeditClickPosField,
+        MaxTextLengthField,
+        PlatformDataField,
+        //! Attributes without a typed field
+        OtherAttributesField,
+        FieldCount
+    };
+
+    //! Bitmask of (1 << Field) values
+    typedef quint32 Fields;
+
+    MImWidgetState();
+
+    //! Builds the state from an attribute map.
+    static MImWidgetState fromMap(const QMap<QString, QVariant> &map);
+
+    //! Returns the state as an attribute map, containing only valid fields.
+    QMap<QString, QVariant> toMap() const;
+
+    //! Returns the attribute name of \a field, or 0 for OtherAttributesField.
+    static const char *fieldName(Field field);
+
+    //! Returns the field of attribute \a name, or OtherAttributesField if it has none.
+    static Field fieldForName(const QString &name);
+
+    static Fields fieldMask(Field field) { return Fields(1) << field; }
+
+    //! Returns true if \a field has been set.
+    bool isValid(Field field) const { return m_validFields & fieldMask(field); }
+    Fields validFields() const { return m_validFields; }
+
+    //! Returns the fields which differ from \a other, including validity changes.
+    Fields changedFields(const MImWidgetState &other) const;
+
+    //! Returns value of \a field as QVariant, or an invalid QVariant if not set.
+    QVariant value(Field field) const;
+    //! Sets \a field from a QVariant. An invalid \a value unsets the field.
+    void setValue(Field field, const QVariant &value);
+    void unset(Field field);
+    void clear();
+
+    bool focusState() const { return m_focusState; }
+    int contentType() const { return m_contentType; }
+    int enterKeyType() const { return m_enterKeyType; }
+    bool correctionEnabled() const { return m_correctionEnabled; }
+    bool predictionEnabled() const { return m_predictionEnabled; }
+    bool autoCapitalizationEnabled() const { return m_autoCapitalizationEnabled; }
+    const QString &surroundingText() const { return m_surroundingText; }
+    int anchorPosition() const { return m_anchorPosition; }
+    int cursorPosition() const { return m_cursorPosition; }
+    bool hasSelection() const { return m_hasSelection; }
+    int inputMethodMode() const { return m_inputMethodMode; }
+    int toolbarId() const { return m_toolbarId; }
+    const QString &toolbar() const { return m_toolbar; }
+    WId winId() const { return m_winId; }
+    const QRect &cursorRectangle() const { return m_cursorRectangle; }
+    bool hiddenText() const { return m_hiddenText; }
+    int preeditClickPos() const { return m_preeditClickPos; }
+    int maxTextLength() const { return m_maxTextLength; }
+    const QString &platformData() const { return m_platformData; }
+    const QMap<QString, QVariant> &otherAttributes() const { return m_otherAttributes; }
+
+    void setFocusState(bool focusState);
+    void setContentType(int contentType);
+    void setEnterKeyType(int enterKeyType);
+    void setCorrectionEnabled(bool enabled);
+    void setPredictionEnabled(bool enabled);
+    void setAutoCapitalizationEnabled(bool enabled);
+    void setSurroundingText(const QString &text);
+    void setAnchorPosition(int position);
+    void setCursorPosition(int position);
+    void setHasSelection(bool hasSelection);
+    void setInputMethodMode(int mode);
+    void setToolbarId(int id);
+    void setToolbar(const QString &toolbar);
+    void setWinId(WId id);
+    void setCursorRectangle(const QRect &rectangle);
+    void setHiddenText(bool hidden);
+    void setPreeditClickPos(int position);
+    void setMaxTextLength(int length);
+    void setPlatformData(const QString &data);
+    void setOtherAttribute(const QString &name, const QVariant &value);
+
+private:
+    Fields m_validFields;
+
+    bool m_focusState;
+    int m_contentType;
+    int m_enterKeyType;
+    bool m_correctionEnabled;
+    bool m_predictionEnabled;
+    bool m_autoCapitalizationEnabled;
+    QString m_surroundingText;
+    int m_anchorPosition;
+    int m_cursorPosition;
+    bool m_hasSelection;
+    int m_inputMethodMode;
+    int m_toolbarId;
+    QString m_toolbar;
+    WId m_winId;
+    QRect m_cursorRectangle;
+    bool m_hiddenText;
+    int m_preeditClickPos;
+    int m_maxTextLength;
+    QString m_platformData;
+    QMap<QString, QVariant> m_otherAttributes;
+};
+//! \internal_end
+
+Q_DECLARE_METATYPE(MImWidgetState)
+
+#endif // MIMWIDGETSTATE_H
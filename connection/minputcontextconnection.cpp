@@ -18,29 +18,6 @@
 
 #include <QKeyEvent>
 
-namespace {
-    // attribute names for updateWidgetInformation() map
-    const char * const FocusStateAttribute = "focusState";
-    const char * const ContentTypeAttribute = "contentType";
-    const char * const EnterKeyTypeAttribute = "enterKeyType";
-    const char * const CorrectionAttribute = "correctionEnabled";
-    const char * const PredictionAttribute = "predictionEnabled";
-    const char * const AutoCapitalizationAttribute = "autocapitalizationEnabled";
-    const char * const SurroundingTextAttribute = "surroundingText";
-    const char * const AnchorPositionAttribute = "anchorPosition";
-    const char * const CursorPositionAttribute = "cursorPosition";
-    const char * const HasSelectionAttribute = "hasSelection";
-    const char * const InputMethodModeAttribute = "inputMethodMode";
-    const char * const ToolbarIdAttribute = "toolbarId";
-    const char * const ToolbarAttribute = "toolbar";
-    const char * const WinId = "winId";
-    const char * const CursorRectAttribute = "cursorRectangle";
-    const char * const HiddenTextAttribute = "hiddenText";
-    const char * const PreeditClickPosAttribute = "preeditClickPos";
-    const char * const MaxTextLengthAttribute = "maxTextLength";
-    const char * const PlatformDataAttribute = "platformData";
-}
-
 class MInputContextConnectionPrivate
 {
 public:
@@ -68,6 +45,9 @@ MInputContextConnection::MInputContextConnection(QObject *parent)
     : activeConnection(0)
     , d(new MInputContextConnectionPrivate)
     , lastOrientation(0)
+    , mWidgetState()
+    , mWidgetStateMap()
+    , mChangedWidgetFields(0)
     , mGlobalCorrectionEnabled(false)
     , mRedirectionEnabled(false)
     , mDetectableAutoRepeat(false)
@@ -84,72 +64,63 @@ MInputContextConnection::~MInputContextConnection()
 /* Accessors to widgetState */
 bool MInputContextConnection::focusState(bool &valid)
 {
-    QVariant focusStateVariant = widgetState[FocusStateAttribute];
-    valid = focusStateVariant.isValid();
-    return focusStateVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::FocusStateField);
+    return mWidgetState.focusState();
 }
 
 int MInputContextConnection::contentType(bool &valid)
 {
-    QVariant contentTypeVariant = widgetState[ContentTypeAttribute];
-    return contentTypeVariant.toInt(&valid);
+    valid = mWidgetState.isValid(MImWidgetState::ContentTypeField);
+    return mWidgetState.contentType();
 }
 
 int MInputContextConnection::enterKeyType(bool &valid)
 {
-    QVariant enterKeyTypeVariant = widgetState[EnterKeyTypeAttribute];
-    return enterKeyTypeVariant.toInt(&valid);
+    valid = mWidgetState.isValid(MImWidgetState::EnterKeyTypeField);
+    return mWidgetState.enterKeyType();
 }
 
 bool MInputContextConnection::correctionEnabled(bool &valid)
 {
-    QVariant correctionVariant = widgetState[CorrectionAttribute];
-    valid = correctionVariant.isValid();
-    return correctionVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::CorrectionField);
+    return mWidgetState.correctionEnabled();
 }
 
 
 bool MInputContextConnection::predictionEnabled(bool &valid)
 {
-    QVariant predictionVariant = widgetState[PredictionAttribute];
-    valid = predictionVariant.isValid();
-    return predictionVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::PredictionField);
+    return mWidgetState.predictionEnabled();
 }
 
 bool MInputContextConnection::autoCapitalizationEnabled(bool &valid)
 {
-    QVariant capitalizationVariant = widgetState[AutoCapitalizationAttribute];
-    valid = capitalizationVariant.isValid();
-    return capitalizationVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::AutoCapitalizationField);
+    return mWidgetState.autoCapitalizationEnabled();
 }
 
 QRect MInputContextConnection::cursorRectangle(bool &valid)
 {
-    QVariant cursorRectVariant = widgetState[CursorRectAttribute];
-    valid = cursorRectVariant.isValid();
-    return cursorRectVariant.toRect();
+    valid = mWidgetState.isValid(MImWidgetState::CursorRectangleField);
+    return mWidgetState.cursorRectangle();
 }
 
 bool MInputContextConnection::hiddenText(bool &valid)
 {
-    QVariant hiddenTextVariant = widgetState[HiddenTextAttribute];
-    valid = hiddenTextVariant.isValid();
-    return hiddenTextVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::HiddenTextField);
+    return mWidgetState.hiddenText();
 }
 
 bool MInputContextConnection::maxTextLength(int &maxTextLength)
 {
-    QVariant maxTextLengthVariant = widgetState[MaxTextLengthAttribute];
-    maxTextLength = maxTextLengthVariant.toInt();
+    maxTextLength = mWidgetState.maxTextLength();
     return true;
 }
 
 bool MInputContextConnection::platformData(QString &pattern)
 {
-    QVariant textVariant = widgetState[PlatformDataAttribute];
-
-    if (textVariant.isValid()) {
-        pattern = textVariant.toString();
+    if (mWidgetState.isValid(MImWidgetState::PlatformDataField)) {
+        pattern = mWidgetState.platformData();
         return true;
     }
     return false;
@@ -157,12 +128,10 @@ bool MInputContextConnection::platformData(QString &pattern)
 
 bool MInputContextConnection::surroundingText(QString &text, int &cursorPosition)
 {
-    QVariant textVariant = widgetState[SurroundingTextAttribute];
-    QVariant posVariant = widgetState[CursorPositionAttribute];
-
-    if (textVariant.isValid() && posVariant.isValid()) {
-        text = textVariant.toString();
-        cursorPosition = posVariant.toInt();
+    if (mWidgetState.isValid(MImWidgetState::SurroundingTextField)
+        && mWidgetState.isValid(MImWidgetState::CursorPositionField)) {
+        text = mWidgetState.surroundingText();
+        cursorPosition = mWidgetState.cursorPosition();
         return true;
     }
 
@@ -172,15 +141,14 @@ bool MInputContextConnection::surroundingText(QString &text, int &cursorPosition
 
 bool MInputContextConnection::hasSelection(bool &valid)
 {
-    QVariant selectionVariant = widgetState[HasSelectionAttribute];
-    valid = selectionVariant.isValid();
-    return selectionVariant.toBool();
+    valid = mWidgetState.isValid(MImWidgetState::HasSelectionField);
+    return mWidgetState.hasSelection();
 }
 
 int MInputContextConnection::inputMethodMode(bool &valid)
 {
-    QVariant modeVariant = widgetState[InputMethodModeAttribute];
-    return modeVariant.toInt(&valid);
+    valid = mWidgetState.isValid(MImWidgetState::InputMethodModeField);
+    return mWidgetState.inputMethodMode();
 }
 
 QRect MInputContextConnection::preeditRectangle(bool &valid)
@@ -191,37 +159,30 @@ QRect MInputContextConnection::preeditRectangle(bool &valid)
 
 WId MInputContextConnection::winId()
 {
-    QVariant winIdVariant = widgetState[WinId];
-    // after transfer by dbus type can change
-    switch (winIdVariant.type()) {
-    case QVariant::UInt:
-        if (sizeof(uint) >= sizeof(WId))
-            return winIdVariant.toUInt();
-        break;
-    case QVariant::ULongLong:
-        if (sizeof(qulonglong) >= sizeof(WId))
-            return winIdVariant.toULongLong();
-        break;
-    default:
-        if (winIdVariant.canConvert<WId>())
-            return winIdVariant.value<WId>();
-    }
-    return 0;
+    return mWidgetState.winId();
 }
 
 
 int MInputContextConnection::anchorPosition(bool &valid)
 {
-    QVariant posVariant = widgetState[AnchorPositionAttribute];
-    valid = posVariant.isValid();
-    return posVariant.toInt();
+    valid = mWidgetState.isValid(MImWidgetState::AnchorPositionField);
+    return mWidgetState.anchorPosition();
 }
 
 int MInputContextConnection::preeditClickPos(bool &valid) const
 {
-    QVariant selectionVariant = widgetState[PreeditClickPosAttribute];
-    valid = selectionVariant.isValid();
-    return selectionVariant.toInt();
+    valid = mWidgetState.isValid(MImWidgetState::PreeditClickPosField);
+    return mWidgetState.preeditClickPos();
+}
+
+const MImWidgetState &MInputContextConnection::widgetState() const
+{
+    return mWidgetState;
+}
+
+MImWidgetState::Fields MInputContextConnection::changedWidgetFields() const
+{
+    return mChangedWidgetFields;
 }
 
 /* End accessors to widget state */
@@ -288,15 +249,65 @@ MInputContextConnection::updateWidgetInformation(
     unsigned int connectionId, const QMap<QString, QVariant> &stateInfo,
     bool handleFocusChange)
 {
-    QMap<QString, QVariant> oldState = widgetState;
+    const MImWidgetState state = MImWidgetState::fromMap(stateInfo);
+    applyWidgetState(connectionId, state, state.changedFields(mWidgetState), stateInfo, handleFocusChange);
+}
+
+void
+MInputContextConnection::updateWidgetInformation(
+    unsigned int connectionId, const MImWidgetState &state,
+    bool handleFocusChange)
+{
+    const MImWidgetState::Fields changed = state.changedFields(mWidgetState);
+
+    // Only the changed fields are written, so an unchanged state keeps
+    // sharing the map data instead of building it again
+    QMap<QString, QVariant> stateMap = mWidgetStateMap;
+    for (int field = 0; field < MImWidgetState::FieldCount; ++field) {
+        if (!(changed & MImWidgetState::fieldMask(static_cast<MImWidgetState::Field>(field)))) {
+            continue;
+        }
+
+        if (field == MImWidgetState::OtherAttributesField) {
+            Q_FOREACH (const QString &name, mWidgetState.otherAttributes().keys()) {
+                stateMap.remove(name);
+            }
+            for (QMap<QString, QVariant>::const_iterator i = state.otherAttributes().constBegin();
+                 i != state.otherAttributes().constEnd(); ++i) {
+                stateMap.insert(i.key(), i.value());
+            }
+            continue;
+        }
+
+        const MImWidgetState::Field typedField = static_cast<MImWidgetState::Field>(field);
+        const QString name = QString::fromLatin1(MImWidgetState::fieldName(typedField));
+        if (state.isValid(typedField)) {
+            stateMap.insert(name, state.value(typedField));
+        } else {
+            stateMap.remove(name);
+        }
+    }
+
+    applyWidgetState(connectionId, state, changed, stateMap, handleFocusChange);
+}
+
+void MInputContextConnection::applyWidgetState(unsigned int connectionId,
+                                               const MImWidgetState &state,
+                                               MImWidgetState::Fields changedFields,
+                                               const QMap<QString, QVariant> &stateMap,
+                                               bool handleFocusChange)
+{
+    const QMap<QString, QVariant> oldState = mWidgetStateMap;
 
-    widgetState = stateInfo;
+    mChangedWidgetFields = changedFields;
+    mWidgetState = state;
+    mWidgetStateMap = stateMap;
 
     if (handleFocusChange) {
         Q_EMIT focusChanged(winId());
     }
 
-    Q_EMIT widgetStateChanged(connectionId, widgetState, oldState, handleFocusChange);
+    Q_EMIT widgetStateChanged(connectionId, mWidgetStateMap, oldState, handleFocusChange);
 }
 
 void
@@ -347,9 +358,9 @@ void MInputContextConnection::processKeyEvent(
     if (activeConnection != connectionId)
         return;
 
-    Q_EMIT receivedKeyEvent(keyType, keyCode,
-                            modifiers, text, autoRepeat, count,
-                            nativeScanCode, nativeModifiers, time);
+    const MImKeyEvent event = { keyType, keyCode, modifiers, text, autoRepeat, count,
+                                nativeScanCode, nativeModifiers, time };
+    Q_EMIT receivedKeyEvent(event);
 }
 
 void MInputContextConnection::registerAttributeExtension(unsigned int connectionId, int id,
@@ -24,6 +24,8 @@
 
 #include <maliit/settingdata.h>
 
+#include "mimwidgetstate.h"
+
 class QKeyEvent;
 
 class MInputContextConnectionPrivate;
@@ -31,6 +33,24 @@ class MAbstractInputMethod;
 class MAttributeExtensionId;
 class MImPluginSettingsInfo;
 
+/*! \internal
+ * \ingroup maliitserver
+ * \brief Key event passed from the connection to the plugin manager.
+ */
+struct MImKeyEvent
+{
+    QEvent::Type type;
+    Qt::Key key;
+    Qt::KeyboardModifiers modifiers;
+    QString text;
+    bool autoRepeat;
+    int count;
+    quint32 nativeScanCode;
+    quint32 nativeModifiers;
+    unsigned long time;
+};
+Q_DECLARE_METATYPE(MImKeyEvent)
+
 /*! \internal
  * \ingroup maliitserver
  * \brief Base class of the input method communication implementation between
@@ -47,6 +67,9 @@ public:
 
     virtual void setDisplayId(int displayId) {}
 
+    //! Returns the display this connection serves, or -1 if it was never set.
+    virtual int displayId() const { return -1; }
+
     /*!
      * \brief Returns focus state if output parameter \a valid is \c true.
      *
@@ -258,6 +281,17 @@ public: // Inbound communication handlers
                                  const QMap<QString, QVariant> &stateInformation,
                                  bool focusChanged);
 
+    //! \overload
+    void updateWidgetInformation(unsigned int clientId,
+                                 const MImWidgetState &state,
+                                 bool focusChanged);
+
+    //! Returns the current widget state.
+    const MImWidgetState &widgetState() const;
+
+    //! Returns the fields changed by the last widget state update.
+    MImWidgetState::Fields changedWidgetFields() const;
+
     //! ipc method provided to the application, resets the input method
     void reset(unsigned int clientId);
 
@@ -378,9 +412,7 @@ Q_SIGNALS:
     void preeditChanged(const QString &text, int cursorPos);
     void mouseClickedOnPreedit(const QPoint &pos, const QRect &preeditRect);
 
-    void receivedKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
-                         Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat,
-                         int count, quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    void receivedKeyEvent(const MImKeyEvent &event);
 
 protected:
     unsigned int activeConnection; // 0 means no active connection
@@ -398,12 +430,20 @@ private:
      */
     WId winId();
 
+    void applyWidgetState(unsigned int connectionId,
+                          const MImWidgetState &state,
+                          MImWidgetState::Fields changedFields,
+                          const QMap<QString, QVariant> &stateMap,
+                          bool focusChanged);
+
 private:
     MInputContextConnectionPrivate *d;
     int lastOrientation;
 
-    /* FIXME: rename with m prefix, and provide protected accessors for derived classes */
-    QMap<QString, QVariant> widgetState;
+    MImWidgetState mWidgetState;
+    // Map view of mWidgetState, as sent with widgetStateChanged()
+    QMap<QString, QVariant> mWidgetStateMap;
+    MImWidgetState::Fields mChangedWidgetFields;
     bool mGlobalCorrectionEnabled;
     bool mRedirectionEnabled;
     bool mDetectableAutoRepeat;
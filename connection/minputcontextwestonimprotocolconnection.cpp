@@ -13,10 +13,13 @@
  */
 
 #include <cerrno> // for errno
+#include <cstddef> // for size_t
 #include <cstring> // for strerror
 #include <unistd.h> // for close
+#include <QCryptographicHash>
 #include <QGuiApplication>
 #include <QKeyEvent>
+#include <QTimer>
 #include <qweboskeyextension.h>
 #include <qpa/qplatformnativeinterface.h>
 
@@ -32,33 +35,18 @@
 #include <xkbcommon/xkbcommon.h>
 
 #include "minputcontextwestonimprotocolconnection.h"
+#include "mimwidgetstate.h"
+#include "utf8offsetindex.h"
 
 namespace {
 
-// TODO: Deduplicate it. Those values are used in
-// minputcontextconnection, mimpluginmanager,
-// mattributeextensionmanager and in input context implementations.
-const char * const FocusStateAttribute = "focusState";
-const char * const ContentTypeAttribute = "contentType";
-const char * const EnterKeyTypeAttribute = "enterKeyType";
-const char * const CorrectionAttribute = "correctionEnabled";
-const char * const PredictionAttribute = "predictionEnabled";
-const char * const AutoCapitalizationAttribute = "autocapitalizationEnabled";
-const char * const SurroundingTextAttribute = "surroundingText";
-const char * const AnchorPositionAttribute = "anchorPosition";
-const char * const CursorPositionAttribute = "cursorPosition";
-const char * const HasSelectionAttribute = "hasSelection";
-const char * const HiddenTextAttribute = "hiddenText";
-const char * const MaxTextLengthAttribute = "maxTextLength";
-const char * const PlatformDataAttribute = "platformData";
-
 struct XkbQtKey
 {
     xkb_keysym_t xkbkey;
     int qtkey;
 };
 
-static const struct XkbQtKey g_XkbQtKeyMap[] = {
+constexpr XkbQtKey g_XkbQtKeyMap[] = {
     { XKB_KEY_Shift_L,     Qt::Key_Shift },
     { XKB_KEY_Control_L,   Qt::Key_Control },
     { XKB_KEY_Super_L,     Qt::Key_Super_L },
@@ -222,7 +210,7 @@ static const struct XkbQtKey g_XkbQtKeyMap[] = {
     { XKB_KEY_Cancel,      Qt::Key_MediaStop },
 };
 
-static const struct XkbQtKey g_XkbQtKeypadMap[] = {
+constexpr XkbQtKey g_XkbQtKeypadMap[] = {
     { XKB_KEY_KP_Divide,   Qt::Key_Slash },
     { XKB_KEY_KP_Multiply, Qt::Key_Asterisk },
     { XKB_KEY_KP_Subtract, Qt::Key_Minus },
@@ -266,7 +254,7 @@ static const struct XkbQtKey g_XkbQtKeypadMap[] = {
     { Qt::Key_9,           Qt::Key_9 },
 };
 
-static const struct XkbQtKey g_XkbQtMediaMap[] = {
+constexpr XkbQtKey g_XkbQtMediaMap[] = {
     { XKB_KEY_XF86AudioPlay, Qt::Key_MediaPlay },
     { Qt::Key_MediaPlay,     Qt::Key_MediaPlay },
     { XKB_KEY_XF86AudioStop, Qt::Key_MediaStop },
@@ -284,54 +272,129 @@ static const struct XkbQtKey g_XkbQtMediaMap[] = {
     { Qt::Key_AudioForward,     Qt::Key_AudioForward },
 };
 
-static xkb_keysym_t qtKeyToXkbKey(int qtkey)
+// Fixed size copy of one or more key tables, usable in constant expressions.
+template <typename Entry, std::size_t N>
+struct KeyTable
 {
-    unsigned i;
+    Entry entries[N];
 
-    for (i = 0; i < sizeof(g_XkbQtKeyMap) / sizeof(XkbQtKey); i++) {
-        if (qtkey == g_XkbQtKeyMap[i].qtkey)
-            return g_XkbQtKeyMap[i].xkbkey;
-    }
-    for (i = 0; i < sizeof(g_XkbQtKeypadMap) / sizeof(XkbQtKey); i++) {
-        if (qtkey == g_XkbQtKeypadMap[i].qtkey)
-            return g_XkbQtKeypadMap[i].xkbkey;
-    }
-    for (i = 0; i < sizeof(g_XkbQtMediaMap) / sizeof(XkbQtKey); i++) {
-        if (qtkey == g_XkbQtMediaMap[i].qtkey)
-            return g_XkbQtMediaMap[i].xkbkey;
-    }
+    constexpr std::size_t size() const { return N; }
+};
 
-    return (xkb_keysym_t)qtkey;
+template <typename Entry, std::size_t N>
+constexpr KeyTable<Entry, N> makeKeyTable(const Entry (&source)[N])
+{
+    KeyTable<Entry, N> table{};
+    for (std::size_t i = 0; i < N; ++i)
+        table.entries[i] = source[i];
+    return table;
+}
+
+template <typename Entry, std::size_t N1, std::size_t N2, std::size_t N3>
+constexpr KeyTable<Entry, N1 + N2 + N3> joinKeyTables(const Entry (&first)[N1],
+                                                      const Entry (&second)[N2],
+                                                      const Entry (&third)[N3])
+{
+    KeyTable<Entry, N1 + N2 + N3> table{};
+    for (std::size_t i = 0; i < N1; ++i)
+        table.entries[i] = first[i];
+    for (std::size_t i = 0; i < N2; ++i)
+        table.entries[N1 + i] = second[i];
+    for (std::size_t i = 0; i < N3; ++i)
+        table.entries[N1 + N2 + i] = third[i];
+    return table;
+}
+
+// Stable insertion sort: of several entries with the same key the one
+// coming first in the source tables stays first, which keeps the lookup
+// priority of the former linear scans.
+template <typename Entry, typename Key, std::size_t N>
+constexpr KeyTable<Entry, N> sortKeyTable(KeyTable<Entry, N> table, Key Entry::*key)
+{
+    for (std::size_t i = 1; i < N; ++i) {
+        const Entry entry = table.entries[i];
+        std::size_t j = i;
+        while (j > 0 && entry.*key < table.entries[j - 1].*key) {
+            table.entries[j] = table.entries[j - 1];
+            --j;
+        }
+        table.entries[j] = entry;
+    }
+    return table;
 }
 
-static int xkbKeyToQtKey(xkb_keysym_t xkbkey)
+// Returns the first entry matching value in a table sorted by key, or nullptr.
+template <typename Entry, typename Key, std::size_t N>
+constexpr const Entry *findKey(const KeyTable<Entry, N> &table, Key Entry::*key, Key value)
 {
-    unsigned i;
-
-    for (i = 0; i < sizeof(g_XkbQtKeyMap) / sizeof(XkbQtKey); i++) {
-        if (xkbkey == g_XkbQtKeyMap[i].xkbkey)
-            return g_XkbQtKeyMap[i].qtkey;
+    std::size_t low = 0;
+    std::size_t high = N;
+    while (low < high) {
+        const std::size_t middle = low + (high - low) / 2;
+        if (table.entries[middle].*key < value)
+            low = middle + 1;
+        else
+            high = middle;
     }
-    for (i = 0; i < sizeof(g_XkbQtKeypadMap) / sizeof(XkbQtKey); i++) {
-        if (xkbkey == g_XkbQtKeypadMap[i].xkbkey)
-            return g_XkbQtKeypadMap[i].qtkey;
+    return (low < N && table.entries[low].*key == value) ? &table.entries[low] : nullptr;
+}
+
+// Reference lookup, used to verify the sorted tables at compile time.
+template <typename Entry, typename Key, std::size_t N>
+constexpr const Entry *findKeyLinear(const KeyTable<Entry, N> &table, Key Entry::*key, Key value)
+{
+    for (std::size_t i = 0; i < N; ++i) {
+        if (table.entries[i].*key == value)
+            return &table.entries[i];
     }
-    for (i = 0; i < sizeof(g_XkbQtMediaMap) / sizeof(XkbQtKey); i++) {
-        if (xkbkey == g_XkbQtMediaMap[i].xkbkey)
-            return g_XkbQtMediaMap[i].qtkey;
+    return nullptr;
+}
+
+template <typename Entry, typename Key, typename Value, std::size_t N>
+constexpr bool matchesLinearLookup(const KeyTable<Entry, N> &sorted,
+                                   const KeyTable<Entry, N> &source,
+                                   Key Entry::*key,
+                                   Value Entry::*value)
+{
+    for (std::size_t i = 0; i < N; ++i) {
+        const Entry *found = findKey(sorted, key, source.entries[i].*key);
+        const Entry *expected = findKeyLinear(source, key, source.entries[i].*key);
+        if (!found || !expected || found->*value != expected->*value)
+            return false;
     }
+    return true;
+}
+
+// All tables in lookup priority order, as scanned by the former implementation.
+constexpr KeyTable<XkbQtKey, sizeof(g_XkbQtKeyMap) / sizeof(XkbQtKey)
+                             + sizeof(g_XkbQtKeypadMap) / sizeof(XkbQtKey)
+                             + sizeof(g_XkbQtMediaMap) / sizeof(XkbQtKey)>
+    g_XkbQtAllKeys = joinKeyTables(g_XkbQtKeyMap, g_XkbQtKeypadMap, g_XkbQtMediaMap);
 
-    return (int)xkbkey;
+constexpr auto g_XkbQtByQtKey = sortKeyTable(g_XkbQtAllKeys, &XkbQtKey::qtkey);
+constexpr auto g_XkbQtByXkbKey = sortKeyTable(g_XkbQtAllKeys, &XkbQtKey::xkbkey);
+constexpr auto g_XkbQtKeypadByXkbKey = sortKeyTable(makeKeyTable(g_XkbQtKeypadMap), &XkbQtKey::xkbkey);
+
+static_assert(matchesLinearLookup(g_XkbQtByQtKey, g_XkbQtAllKeys, &XkbQtKey::qtkey, &XkbQtKey::xkbkey),
+              "Sorted Qt key table does not match the source key tables");
+static_assert(matchesLinearLookup(g_XkbQtByXkbKey, g_XkbQtAllKeys, &XkbQtKey::xkbkey, &XkbQtKey::qtkey),
+              "Sorted XKB key table does not match the source key tables");
+
+static xkb_keysym_t qtKeyToXkbKey(int qtkey)
+{
+    const XkbQtKey *entry = findKey(g_XkbQtByQtKey, &XkbQtKey::qtkey, qtkey);
+    return entry ? entry->xkbkey : (xkb_keysym_t)qtkey;
+}
+
+static int xkbKeyToQtKey(xkb_keysym_t xkbkey)
+{
+    const XkbQtKey *entry = findKey(g_XkbQtByXkbKey, &XkbQtKey::xkbkey, xkbkey);
+    return entry ? entry->qtkey : (int)xkbkey;
 }
 
 static bool isKeypadKey(xkb_keysym_t xkbkey)
 {
-    unsigned i;
-    for (i = 0; i < sizeof(g_XkbQtKeypadMap) / sizeof(XkbQtKey); i++) {
-        if (xkbkey == g_XkbQtKeypadMap[i].xkbkey)
-            return true;
-    }
-    return false;
+    return findKey(g_XkbQtKeypadByXkbKey, &XkbQtKey::xkbkey, xkbkey) != nullptr;
 }
 
 struct ModTuple
@@ -403,6 +466,234 @@ wl_array *Modifiers::getModMap()
     return &mod_map;
 }
 
+// Last surrounding text received from the compositor. Consecutive updates
+// mostly differ in a small region around the cursor, or only in the cursor
+// position, so only the changed bytes are decoded again.
+class SurroundingText
+{
+public:
+    enum Change {
+        NoChange = 0,
+        TextChanged = 1 << 0,
+        CursorChanged = 1 << 1,
+        AnchorChanged = 1 << 2
+    };
+
+    SurroundingText();
+
+    //! Applies a new update and returns the changed parts as Change flags.
+    int update(const char *text, int length, uint32_t cursor, uint32_t anchor);
+    void clear();
+
+    const QString &text() const;
+    const Utf8OffsetIndex &offsets() const;
+    uint32_t cursor() const;
+    uint32_t anchor() const;
+
+private:
+    QByteArray m_raw;
+    QString m_text;
+    Utf8OffsetIndex m_offsets;
+    uint32_t m_cursor;
+    uint32_t m_anchor;
+    bool m_valid;
+};
+
+inline bool isContinuationByte(char byte)
+{
+    return (static_cast<unsigned char>(byte) & 0xC0) == 0x80;
+}
+
+SurroundingText::SurroundingText()
+    : m_raw(),
+      m_text(),
+      m_offsets(),
+      m_cursor(0),
+      m_anchor(0),
+      m_valid(false)
+{
+}
+
+int SurroundingText::update(const char *text, int length, uint32_t cursor, uint32_t anchor)
+{
+    if (!m_valid) {
+        m_raw = QByteArray(text, length);
+        m_text = QString::fromUtf8(text, length);
+        m_offsets.reset(m_raw);
+        m_cursor = cursor;
+        m_anchor = anchor;
+        m_valid = true;
+        return TextChanged | CursorChanged | AnchorChanged;
+    }
+
+    int changes = NoChange;
+    const char *old = m_raw.constData();
+    const int oldLength = m_raw.size();
+
+    if (length != oldLength || memcmp(old, text, length) != 0) {
+        const int common = qMin(length, oldLength);
+
+        int prefix = 0;
+        while (prefix < common && old[prefix] == text[prefix]) {
+            ++prefix;
+        }
+        // Do not split a multi-byte sequence of either text
+        while (prefix > 0 && ((prefix < length && isContinuationByte(text[prefix]))
+                              || (prefix < oldLength && isContinuationByte(old[prefix])))) {
+            --prefix;
+        }
+
+        int suffix = 0;
+        while (suffix < common - prefix && old[oldLength - 1 - suffix] == text[length - 1 - suffix]) {
+            ++suffix;
+        }
+        while (suffix > 0 && isContinuationByte(text[length - suffix])) {
+            --suffix;
+        }
+
+        const int removedLength = oldLength - prefix - suffix;
+        const int insertedLength = length - prefix - suffix;
+
+        const int prefix16 = m_offsets.utf16Offset(prefix);
+        m_text.replace(prefix16,
+                       m_offsets.utf16Offset(oldLength - suffix) - prefix16,
+                       QString::fromUtf8(text + prefix, insertedLength));
+        m_raw.replace(prefix, removedLength, text + prefix, insertedLength);
+        m_offsets.reset(m_raw);
+        changes |= TextChanged;
+    }
+
+    if (cursor != m_cursor) {
+        m_cursor = cursor;
+        changes |= CursorChanged;
+    }
+    if (anchor != m_anchor) {
+        m_anchor = anchor;
+        changes |= AnchorChanged;
+    }
+
+    return changes;
+}
+
+void SurroundingText::clear()
+{
+    m_raw.clear();
+    m_text.clear();
+    m_offsets.clear();
+    m_cursor = 0;
+    m_anchor = 0;
+    m_valid = false;
+}
+
+const QString &SurroundingText::text() const
+{
+    return m_text;
+}
+
+const Utf8OffsetIndex &SurroundingText::offsets() const
+{
+    return m_offsets;
+}
+
+uint32_t SurroundingText::cursor() const
+{
+    return m_cursor;
+}
+
+uint32_t SurroundingText::anchor() const
+{
+    return m_anchor;
+}
+
+// Resolved result of a single (keycode, layout, level) lookup.
+struct KeyTableEntry
+{
+    int qtKey;
+    bool keypad;
+    QChar text;
+};
+
+// A compiled keymap together with everything derived from it.
+struct CompiledKeymap
+{
+    xkb_keymap *keymap = nullptr;
+
+    xkb_mod_index_t shift_mod = 0;
+    xkb_mod_index_t caps_mod = 0;
+    xkb_mod_index_t ctrl_mod = 0;
+    xkb_mod_index_t alt_mod = 0;
+    xkb_mod_index_t mod2_mod = 0;
+    xkb_mod_index_t mod3_mod = 0;
+    xkb_mod_index_t super_mod = 0;
+    xkb_mod_index_t mod5_mod = 0;
+    xkb_led_index_t num_led = 0;
+    xkb_led_index_t caps_led = 0;
+    xkb_led_index_t scroll_led = 0;
+
+    // Dense (keycode, layout, level) -> KeyTableEntry table, so that an
+    // incoming key needs no keysym table scans.
+    QVector<KeyTableEntry> keys;
+    xkb_keycode_t min_keycode = 0;
+    xkb_keycode_t max_keycode = 0;
+    xkb_layout_index_t num_layouts = 0;
+    xkb_level_index_t num_levels = 0;
+};
+
+// The compositor resends the keymap on every keyboard grab, so compiled
+// keymaps are kept by the SHA-1 of their text. The cache is shared by all
+// connections of the process and owns the keymap references; connections
+// keep their current keymap alive through their xkb_state.
+struct KeymapCache
+{
+    KeymapCache()
+        : context(xkb_context_new(XKB_CONTEXT_NO_DEFAULT_INCLUDES))
+    {}
+
+    ~KeymapCache()
+    {
+        Q_FOREACH (const CompiledKeymap &compiled, keymaps) {
+            xkb_keymap_unref(compiled.keymap);
+        }
+        if (context) {
+            xkb_context_unref(context);
+        }
+    }
+
+    static KeymapCache *instance()
+    {
+        static KeymapCache cache;
+        return &cache;
+    }
+
+    xkb_context *context;
+    QHash<QByteArray, CompiledKeymap> keymaps;
+    // Digests, most recently used last
+    QList<QByteArray> order;
+};
+
+// Request to the input method context, queued until the end of the
+// current event loop iteration.
+struct OutputRequest
+{
+    enum Type {
+        DeleteSurroundingText,
+        PreeditStyling,
+        PreeditCursor,
+        PreeditString,
+        CursorPosition,
+        CommitString,
+        Keysym
+    };
+
+    Type type;
+    uint32_t serial;
+    // index/length for text requests, time/keysym/state/modifiers for key events
+    uint32_t args[4];
+    QByteArray text;
+    // Whether a preedit was shown before this PreeditString request
+    bool preeditWasActive;
+};
+
 } // unnamed namespace
 
 struct MInputContextWestonIMProtocolConnectionPrivate
@@ -438,10 +729,24 @@ struct MInputContextWestonIMProtocolConnectionPrivate
     void handleInputMethodContextPlatformData(const char *pattern);
 
     void processKeyMap(uint32_t format, uint32_t fd, uint32_t size);
+    void buildKeyTable(CompiledKeymap &compiled);
+    KeyTableEntry lookupKey(uint32_t key) const;
     void processKeyEvent(uint32_t serial, uint32_t time, uint32_t key, uint32_t state);
     void processKeyModifiers(uint32_t serial, uint32_t mods_depressed, uint32_t
             mods_latched, uint32_t mods_locked, uint32_t group);
 
+    void queueRequest(OutputRequest::Type type,
+                      uint32_t arg0 = 0, uint32_t arg1 = 0,
+                      uint32_t arg2 = 0, uint32_t arg3 = 0,
+                      const QByteArray &text = QByteArray());
+    //! Queues \a text; an empty one is only sent if it clears a preedit, or if \a force is set
+    void queuePreeditString(const QByteArray &text, bool force = false);
+    void dropPendingPreedit();
+    void _q_flushRequests();
+
+    void stageWidgetState();
+    void _q_publishWidgetState();
+
     MInputContextWestonIMProtocolConnection *q_ptr;
     wl_display *display;
     wl_registry *registry;
@@ -449,27 +754,30 @@ struct MInputContextWestonIMProtocolConnectionPrivate
     input_method_context *im_context;
     uint32_t im_serial;
     QString selection;
+    SurroundingText surrounding_text;
     Modifiers mods;
-    QMap<QString, QVariant> state_info;
+    MImWidgetState state_info;
+
+    // Context events only update state_info. The state is published once per
+    // commit or dispatch batch, and before any event which depends on it.
+    QTimer publish_timer;
+    bool state_staged;
+    bool focus_change_staged;
+    bool activation_staged;
 
     struct {
-        xkb_context *context = nullptr;
-        xkb_keymap *keymap = nullptr;
         xkb_state *state = nullptr;
 
-        xkb_mod_index_t shift_mod = 0;
-        xkb_mod_index_t caps_mod = 0;
-        xkb_mod_index_t ctrl_mod = 0;
-        xkb_mod_index_t alt_mod = 0;
-        xkb_mod_index_t mod2_mod = 0;
-        xkb_mod_index_t mod3_mod = 0;
-        xkb_mod_index_t super_mod = 0;
-        xkb_mod_index_t mod5_mod = 0;
-        xkb_led_index_t num_led = 0;
-        xkb_led_index_t caps_led = 0;
-        xkb_led_index_t scroll_led = 0;
+        // Current keymap, referenced by state
+        CompiledKeymap map;
     } xkb;
 
+    // Requests are sent in one batch per event loop iteration, with redundant
+    // preedit updates dropped. preedit_active is the state after the queue.
+    QVector<OutputRequest> pending_requests;
+    QTimer flush_timer;
+    bool preedit_active;
+
     Qt::KeyboardModifiers modifiers;
     int m_displayId;
 };
@@ -477,6 +785,8 @@ struct MInputContextWestonIMProtocolConnectionPrivate
 namespace {
 
 const unsigned int connection_id(1);
+const uint32_t EVDEV_OFFSET = 8;
+const int MAX_CACHED_KEYMAPS = 4;
 
 void registryGlobal(void *data,
                     wl_registry *registry,
@@ -774,10 +1084,25 @@ MInputContextWestonIMProtocolConnectionPrivate::MInputContextWestonIMProtocolCon
       im_context(0),
       im_serial(0),
       selection(),
+      surrounding_text(),
       mods(),
       state_info(),
+      publish_timer(),
+      state_staged(false),
+      focus_change_staged(false),
+      activation_staged(false),
+      pending_requests(),
+      flush_timer(),
+      preedit_active(false),
       m_displayId(-1)
 {
+    flush_timer.setSingleShot(true);
+    flush_timer.setInterval(0);
+    QObject::connect(&flush_timer, SIGNAL(timeout()), q_ptr, SLOT(_q_flushRequests()));
+    publish_timer.setSingleShot(true);
+    publish_timer.setInterval(0);
+    QObject::connect(&publish_timer, SIGNAL(timeout()), q_ptr, SLOT(_q_publishWidgetState()));
+
     display = static_cast<wl_display *>(QGuiApplication::platformNativeInterface()->nativeResourceForIntegration("display"));
     if (!display) {
         qCritical() << "Failed to get a display.";
@@ -786,12 +1111,11 @@ MInputContextWestonIMProtocolConnectionPrivate::MInputContextWestonIMProtocolCon
     registry = wl_display_get_registry(display);
     wl_registry_add_listener(registry, &maliit_registry_listener, this);
     // QtWayland will do dispatching for us.
-
-    xkb.context = xkb_context_new(XKB_CONTEXT_NO_DEFAULT_INCLUDES);
 }
 
 MInputContextWestonIMProtocolConnectionPrivate::~MInputContextWestonIMProtocolConnectionPrivate()
 {
+    _q_flushRequests();
     if (im_context) {
         input_method_context_destroy(im_context);
     }
@@ -804,12 +1128,6 @@ MInputContextWestonIMProtocolConnectionPrivate::~MInputContextWestonIMProtocolCo
     if (xkb.state) {
         xkb_state_unref(xkb.state);
     }
-    if (xkb.keymap) {
-        xkb_keymap_unref(xkb.keymap);
-    }
-    if (xkb.context) {
-        xkb_context_unref(xkb.context);
-    }
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::setDisplayId(int displayId)
@@ -915,37 +1233,63 @@ void MInputContextWestonIMProtocolConnectionPrivate::processKeyMap(uint32_t form
             return;
         }
 
-        xkb_keymap *newKeymap = xkb_keymap_new_from_string(xkb.context,
-                keymapArea, XKB_KEYMAP_FORMAT_TEXT_V1,
-                XKB_MAP_COMPILE_PLACEHOLDER);
+        const QByteArray digest(QCryptographicHash::hash(QByteArray::fromRawData(keymapArea, size),
+                                                         QCryptographicHash::Sha1));
 
-        munmap(keymapArea, size);
-        close(fd);
+        KeymapCache *cache = KeymapCache::instance();
+        QHash<QByteArray, CompiledKeymap>::const_iterator cached = cache->keymaps.constFind(digest);
+        if (cached != cache->keymaps.constEnd()) {
+            munmap(keymapArea, size);
+            close(fd);
 
-        // free existing keymap
-        if (xkb.keymap) {
-            xkb_keymap_unref(xkb.keymap);
+            xkb.map = cached.value();
+            cache->order.removeOne(digest);
+            cache->order.append(digest);
+        } else {
+            xkb_keymap *newKeymap = xkb_keymap_new_from_string(cache->context,
+                    keymapArea, XKB_KEYMAP_FORMAT_TEXT_V1,
+                    XKB_MAP_COMPILE_PLACEHOLDER);
+
+            munmap(keymapArea, size);
+            close(fd);
+
+            if (!newKeymap) {
+                qWarning() << "failed to compile keymap";
+                return;
+            }
+
+            CompiledKeymap compiled;
+            compiled.keymap = newKeymap;
+
+            // set modifier index
+            compiled.shift_mod = xkb_map_mod_get_index(newKeymap, XKB_MOD_NAME_SHIFT);
+            compiled.caps_mod = xkb_map_mod_get_index(newKeymap, XKB_MOD_NAME_CAPS);
+            compiled.ctrl_mod = xkb_map_mod_get_index(newKeymap, XKB_MOD_NAME_CTRL);
+            compiled.alt_mod = xkb_map_mod_get_index(newKeymap, XKB_MOD_NAME_ALT);
+            compiled.mod2_mod = xkb_map_mod_get_index(newKeymap, "Mod2");
+            compiled.mod3_mod = xkb_map_mod_get_index(newKeymap, "Mod3");
+            compiled.super_mod = xkb_map_mod_get_index(newKeymap, XKB_MOD_NAME_LOGO);
+            compiled.mod5_mod = xkb_map_mod_get_index(newKeymap, "Mod5");
+
+            compiled.num_led = xkb_map_led_get_index(newKeymap, XKB_LED_NAME_NUM);
+            compiled.caps_led = xkb_map_led_get_index(newKeymap, XKB_LED_NAME_CAPS);
+            compiled.scroll_led = xkb_map_led_get_index(newKeymap, XKB_LED_NAME_SCROLL);
+
+            buildKeyTable(compiled);
+
+            cache->keymaps.insert(digest, compiled);
+            cache->order.append(digest);
+            while (cache->order.size() > MAX_CACHED_KEYMAPS) {
+                xkb_keymap_unref(cache->keymaps.take(cache->order.takeFirst()).keymap);
+            }
+
+            xkb.map = compiled;
         }
-        xkb.keymap = newKeymap;
 
         if (xkb.state) {
             xkb_state_unref(xkb.state);
         }
-        xkb.state = xkb_state_new(xkb.keymap);
-
-        // set modifier index
-        xkb.shift_mod = xkb_map_mod_get_index(xkb.keymap, XKB_MOD_NAME_SHIFT);
-        xkb.caps_mod = xkb_map_mod_get_index(xkb.keymap, XKB_MOD_NAME_CAPS);
-        xkb.ctrl_mod = xkb_map_mod_get_index(xkb.keymap, XKB_MOD_NAME_CTRL);
-        xkb.alt_mod = xkb_map_mod_get_index(xkb.keymap, XKB_MOD_NAME_ALT);
-        xkb.mod2_mod = xkb_map_mod_get_index(xkb.keymap, "Mod2");
-        xkb.mod3_mod = xkb_map_mod_get_index(xkb.keymap, "Mod3");
-        xkb.super_mod = xkb_map_mod_get_index(xkb.keymap, XKB_MOD_NAME_LOGO);
-        xkb.mod5_mod = xkb_map_mod_get_index(xkb.keymap, "Mod5");
-
-        xkb.num_led = xkb_map_led_get_index(xkb.keymap, XKB_LED_NAME_NUM);
-        xkb.caps_led = xkb_map_led_get_index(xkb.keymap, XKB_LED_NAME_CAPS);
-        xkb.scroll_led = xkb_map_led_get_index(xkb.keymap, XKB_LED_NAME_SCROLL);
+        xkb.state = xkb_state_new(xkb.map.keymap);
     }
 }
 
@@ -985,13 +1329,93 @@ static xkb_keysym_t get_remote_keysym(uint32_t key)
     return XKB_KEY_NoSymbol;
 }
 
+static KeyTableEntry resolveKeysym(xkb_keysym_t sym, uint32_t key)
+{
+    // Check keysym mapping for RC buttons
+    if (sym == XKB_KEY_NoSymbol)
+        sym = get_remote_keysym(key);
+
+    KeyTableEntry entry;
+    entry.qtKey = xkbKeyToQtKey(sym);
+    entry.keypad = isKeypadKey(sym);
+    if ((XKB_KEY_A <= sym && sym <= XKB_KEY_Z) ||
+        (XKB_KEY_a <= sym && sym <= XKB_KEY_z)) {
+        entry.text = QChar(sym);
+    }
+    return entry;
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::buildKeyTable(CompiledKeymap &compiled)
+{
+    const xkb_keycode_t minKeycode = xkb_keymap_min_keycode(compiled.keymap);
+    const xkb_keycode_t maxKeycode = xkb_keymap_max_keycode(compiled.keymap);
+    const xkb_layout_index_t numLayouts = xkb_keymap_num_layouts(compiled.keymap);
+    xkb_level_index_t numLevels = 0;
+
+    if (maxKeycode < minKeycode || numLayouts == 0) {
+        return;
+    }
+
+    for (xkb_keycode_t keycode = minKeycode; keycode <= maxKeycode; ++keycode) {
+        const xkb_layout_index_t keyLayouts = xkb_keymap_num_layouts_for_key(compiled.keymap, keycode);
+        for (xkb_layout_index_t layout = 0; layout < keyLayouts; ++layout) {
+            numLevels = qMax(numLevels, xkb_keymap_num_levels_for_key(compiled.keymap, keycode, layout));
+        }
+    }
+    if (numLevels == 0) {
+        return;
+    }
+
+    const int size = (maxKeycode - minKeycode + 1) * numLayouts * numLevels;
+    compiled.keys.reserve(size);
+
+    for (xkb_keycode_t keycode = minKeycode; keycode <= maxKeycode; ++keycode) {
+        for (xkb_layout_index_t layout = 0; layout < numLayouts; ++layout) {
+            for (xkb_level_index_t level = 0; level < numLevels; ++level) {
+                const xkb_keysym_t *syms;
+                int num_syms = xkb_keymap_key_get_syms_by_level(compiled.keymap, keycode, layout, level, &syms);
+                compiled.keys.append(resolveKeysym(1 == num_syms ? syms[0] : XKB_KEY_NoSymbol,
+                                                   keycode - EVDEV_OFFSET));
+            }
+        }
+    }
+
+    compiled.min_keycode = minKeycode;
+    compiled.max_keycode = maxKeycode;
+    compiled.num_layouts = numLayouts;
+    compiled.num_levels = numLevels;
+}
+
+KeyTableEntry MInputContextWestonIMProtocolConnectionPrivate::lookupKey(uint32_t key) const
+{
+    const xkb_keycode_t keycode = key + EVDEV_OFFSET;
+
+    if (xkb.state && !xkb.map.keys.isEmpty() &&
+        xkb.map.min_keycode <= keycode && keycode <= xkb.map.max_keycode) {
+        const xkb_layout_index_t layout = xkb_state_key_get_layout(xkb.state, keycode);
+        if (layout < xkb.map.num_layouts) {
+            const xkb_level_index_t level = xkb_state_key_get_level(xkb.state, keycode, layout);
+            if (level < xkb.map.num_levels) {
+                return xkb.map.keys.at(((keycode - xkb.map.min_keycode) * xkb.map.num_layouts
+                                        + layout) * xkb.map.num_levels + level);
+            }
+        }
+    }
+
+    // Keys outside of the keymap (e.g. remote control buttons) are resolved directly
+    const xkb_keysym_t *syms;
+    int num_syms = xkb_key_get_syms(xkb.state, keycode, &syms);
+    // TODO: multiple key press?
+    return resolveKeysym(1 == num_syms ? syms[0] : XKB_KEY_NoSymbol, key);
+}
+
 #ifdef HAS_LIBIM
 struct LGRemoteKey {
     uint32_t lgKey;
     uint32_t normalKey;
 };
 
-static const struct LGRemoteKey g_LGRemoteKeyMap[] = {
+constexpr LGRemoteKey g_LGRemoteKeyMap[] = {
     { IR_KEY_BS_NUM_1, KEY_NUMERIC_1 },
     { IR_KEY_BS_NUM_2, KEY_NUMERIC_2 },
     { IR_KEY_BS_NUM_3, KEY_NUMERIC_3 },
@@ -1060,18 +1484,21 @@ static const struct LGRemoteKey g_LGRemoteKeyMap[] = {
 
 };
 
+constexpr auto g_LGRemoteKeys = makeKeyTable(g_LGRemoteKeyMap);
+constexpr auto g_LGRemoteKeysByLgKey = sortKeyTable(g_LGRemoteKeys, &LGRemoteKey::lgKey);
+
+static_assert(matchesLinearLookup(g_LGRemoteKeysByLgKey, g_LGRemoteKeys,
+                                  &LGRemoteKey::lgKey, &LGRemoteKey::normalKey),
+              "Sorted LG remote key table does not match the source key table");
+
 static uint32_t check_lgremote_key(uint32_t key)
 {
     // Immediately drop normal keys
     if (key < KEY_LG_BASE)
         return key;
 
-    for (unsigned i = 0; i < sizeof(g_LGRemoteKeyMap) / sizeof(LGRemoteKey); i++) {
-        if (key == g_LGRemoteKeyMap[i].lgKey)
-            return g_LGRemoteKeyMap[i].normalKey;
-    }
-
-    return key;
+    const LGRemoteKey *entry = findKey(g_LGRemoteKeysByLgKey, &LGRemoteKey::lgKey, key);
+    return entry ? entry->normalKey : key;
 }
 
 static bool is_lgremote_numbersign(uint32_t key)
@@ -1104,38 +1531,26 @@ void MInputContextWestonIMProtocolConnectionPrivate::processKeyEvent(uint32_t se
         return;
     }
 
-    const uint32_t EVDEV_OFFSET = 8;
+    _q_publishWidgetState();
 
     QEvent::Type keyType = (state == WL_KEYBOARD_KEY_STATE_RELEASED ? QEvent::KeyRelease : QEvent::KeyPress);
 #ifdef HAS_LIBIM
     key = check_lgremote_key(key);
 #endif
 
-    const xkb_keysym_t *syms;
     if (UINT_MAX - key < EVDEV_OFFSET) {
         qWarning() << "Sum EVDEV_OFFSET and key value exceeds UINT_MAX. Before: " << key + EVDEV_OFFSET << ", After: " << UINT_MAX;
         return;
     }
-    int num_syms = xkb_key_get_syms(xkb.state, key + EVDEV_OFFSET, &syms);
-
-    xkb_keysym_t sym = XKB_KEY_NoSymbol;
-    if (1 == num_syms)
-        sym = syms[0];
-    // TODO: multiple key press?
+    const KeyTableEntry entry = lookupKey(key);
+    int keyCode = entry.qtKey;
 
-    // Check keysym mapping for RC buttons
-    if (sym == XKB_KEY_NoSymbol)
-        sym = get_remote_keysym(key);
-
-    int keyCode = xkbKeyToQtKey(sym);
-
-    if (isKeypadKey(sym))
+    if (entry.keypad)
         modifiers |= Qt::KeypadModifier;
 
     QString text("");
-    if ((XKB_KEY_A <= sym && sym <= XKB_KEY_Z) ||
-        (XKB_KEY_a <= sym && sym <= XKB_KEY_z)) {
-        text.append(QChar(sym));
+    if (!entry.text.isNull()) {
+        text.append(entry.text);
     }
 
 #ifdef HAS_LIBIM
@@ -1164,11 +1579,11 @@ void MInputContextWestonIMProtocolConnectionPrivate::processKeyModifiers(uint32_
 
     uint32_t mods_lookup = mods_depressed | mods_latched;
     modifiers = Qt::NoModifier;
-    if (mods_lookup & (1 << xkb.ctrl_mod))
+    if (mods_lookup & (1 << xkb.map.ctrl_mod))
         modifiers |= Qt::ControlModifier;
-    if (mods_lookup & (1 << xkb.alt_mod))
+    if (mods_lookup & (1 << xkb.map.alt_mod))
         modifiers |= Qt::AltModifier;
-    if (mods_lookup & (1 << xkb.shift_mod))
+    if (mods_lookup & (1 << xkb.map.shift_mod))
         modifiers |= Qt::ShiftModifier;
 
     xkb_state_update_mask(xkb.state, mods_depressed, mods_latched, mods_locked, 0, 0, group);
@@ -1177,12 +1592,13 @@ void MInputContextWestonIMProtocolConnectionPrivate::processKeyModifiers(uint32_
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodActivate(input_method_context *context,
                                                                                uint32_t serial)
 {
-    Q_Q(MInputContextWestonIMProtocolConnection);
-
     qDebug() << "context:" << (long) context << "serial:" << serial;
+    _q_publishWidgetState();
     if (im_context) {
+        _q_flushRequests();
         input_method_context_destroy(im_context);
     }
+    preedit_active = false;
     im_context = context;
     im_serial = serial;
     input_method_context_add_listener(im_context, &maliit_input_method_context_listener, this);
@@ -1192,16 +1608,19 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodActivate(i
 
     input_method_context_modifiers_map(im_context, mods.getModMap());
 
-    state_info[FocusStateAttribute] = true;
+    surrounding_text.clear();
+    state_info.setFocusState(true);
 
     //Even if user hasn't set these property, followings should have a default value.
     //See GlobalInputMethod::show() in imemanager.
-    state_info[ContentTypeAttribute] = Maliit::FreeTextContentType;
-    state_info[EnterKeyTypeAttribute] = Maliit::DefaultEnterKeyType;
+    state_info.setContentType(Maliit::FreeTextContentType);
+    state_info.setEnterKeyType(Maliit::DefaultEnterKeyType);
 
-    q->updateWidgetInformation(connection_id, state_info, true);
-    q->activateContext(connection_id);
-    q->showInputMethod(connection_id);
+    // The compositor sends the widget properties right after activation,
+    // so activation is published together with them.
+    focus_change_staged = true;
+    activation_staged = true;
+    stageWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodShowInputPanel(input_method_context *context)
@@ -1211,6 +1630,7 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodShowInputP
     if (!im_context) {
         return;
     }
+    _q_publishWidgetState();
     q->showInputMethod(connection_id);
 }
 
@@ -1221,6 +1641,7 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodHideInputP
     if (!im_context) {
         return;
     }
+    _q_publishWidgetState();
     q->hideInputMethod(connection_id);
 }
 
@@ -1231,10 +1652,14 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodDeactivate
     if (!im_context) {
         return;
     }
+    _q_publishWidgetState();
+    _q_flushRequests();
     input_method_context_destroy(im_context);
     im_context = NULL;
+    surrounding_text.clear();
+    selection.clear();
     state_info.clear();
-    state_info[FocusStateAttribute] = false;
+    state_info.setFocusState(false);
     q->updateWidgetInformation(connection_id, state_info, true);
     q->hideInputMethod(connection_id);
     q->handleDisconnection(connection_id);
@@ -1244,8 +1669,6 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextSur
                                                                                              uint32_t cursor,
                                                                                              uint32_t anchor)
 {
-    Q_Q(MInputContextWestonIMProtocolConnection);
-
     qDebug() << "text:" << text << "cursor:" << cursor << "anchor:" << anchor;
 
     unsigned long textlen = strlen(text);
@@ -1265,23 +1688,31 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextSur
     }
     anchor = len < (int) anchor ? len : anchor;
 
-    state_info[SurroundingTextAttribute] = QString(text);
-    state_info[CursorPositionAttribute] = cursor;
-    state_info[AnchorPositionAttribute] = anchor;
-    state_info[HasSelectionAttribute] = (cursor != anchor);
+    const int changes = surrounding_text.update(text, len, cursor, anchor);
+    if (changes == SurroundingText::NoChange) {
+        return;
+    }
+
+    // cursor and anchor are byte offsets, the widget state holds QString indices
+    const Utf8OffsetIndex &offsets(surrounding_text.offsets());
+    const int cursorPosition = offsets.utf16Offset(cursor);
+    const int anchorPosition = offsets.utf16Offset(anchor);
+
+    if (changes & SurroundingText::TextChanged) {
+        state_info.setSurroundingText(surrounding_text.text());
+    }
+    state_info.setCursorPosition(cursorPosition);
+    state_info.setAnchorPosition(anchorPosition);
+    state_info.setHasSelection(cursor != anchor);
     if (cursor == anchor) {
         selection.clear();
     } else {
-        uint32_t begin(qMin(cursor, anchor));
-        uint32_t end(qMax(cursor, anchor));
+        const int begin(qMin(cursorPosition, anchorPosition));
+        const int end(qMax(cursorPosition, anchorPosition));
 
-        if (INT_MAX - end < begin) {
-            qWarning() << "Sum begin and end value exceeds INT_MAX. Before: " << begin + end << ", After: " << INT_MAX;
-            return;
-        }
-        selection = QString::fromUtf8(text + begin, end - begin);
+        selection = surrounding_text.text().mid(begin, end - begin);
     }
-    q->updateWidgetInformation(connection_id, state_info, false);
+    stageWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextReset(uint32_t serial)
@@ -1290,49 +1721,46 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextRes
 
     qDebug() << "serial:" << serial;
     im_serial = serial;
+    _q_publishWidgetState();
     q->reset(connection_id);
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextContentType(uint32_t hint,
                                                                                          uint32_t purpose)
 {
-    Q_Q(MInputContextWestonIMProtocolConnection);
-
     qDebug() << "hint:" << hint << "purpose:" << purpose;
 
     if (purpose > INT_MAX) {
         qWarning() << "This conversion from unsigned int to int may result in data lost, because the value exceeds INT_MAX. Before: " << purpose << ", After: " << INT_MAX;
         return;
     }
-    state_info[ContentTypeAttribute] = westonPurposeToMaliit(static_cast<text_model_content_purpose>(purpose));
+    state_info.setContentType(westonPurposeToMaliit(static_cast<text_model_content_purpose>(purpose)));
     if (hint > INT_MAX) {
         qWarning() << "This conversion from unsigned int to int may result in data lost, because the value exceeds INT_MAX. Before: " << hint << ", After: " << INT_MAX;
         return;
     }
-    state_info[AutoCapitalizationAttribute] = matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_CAPITALIZATION);
-    state_info[CorrectionAttribute] = matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_CORRECTION);
-    state_info[PredictionAttribute] = matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_COMPLETION);
-    state_info[HiddenTextAttribute] = matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_HIDDEN_TEXT)
+    state_info.setAutoCapitalizationEnabled(matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_CAPITALIZATION));
+    state_info.setCorrectionEnabled(matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_CORRECTION));
+    state_info.setPredictionEnabled(matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_AUTO_COMPLETION));
+    state_info.setHiddenText(matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_HIDDEN_TEXT)
         || matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_PASSWORD)
         || matchesFlag(hint, TEXT_MODEL_CONTENT_HINT_SENSITIVE_DATA)
-        || (purpose == TEXT_MODEL_CONTENT_PURPOSE_PASSWORD);
+        || (purpose == TEXT_MODEL_CONTENT_PURPOSE_PASSWORD));
 
-    q->updateWidgetInformation(connection_id, state_info, false);
+    stageWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextEnterKeyType(uint32_t enter_key_type)
 {
-    Q_Q(MInputContextWestonIMProtocolConnection);
-
     qDebug() << "enter_key_type:" << enter_key_type;
 
     if (enter_key_type > INT_MAX) {
         qWarning() << "This conversion from unsigned int to int may result in data lost, because the value exceeds INT_MAX. Before: " << enter_key_type << ", After: " << INT_MAX;
         return;
     }
-    state_info[EnterKeyTypeAttribute] = westonEnterKeyTypeToMaliit(static_cast<text_model_enter_key_type>(enter_key_type));
+    state_info.setEnterKeyType(westonEnterKeyTypeToMaliit(static_cast<text_model_enter_key_type>(enter_key_type)));
 
-    q->updateWidgetInformation(connection_id, state_info, false);
+    stageWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextInvokeAction(uint32_t button,
@@ -1344,6 +1772,7 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextInv
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextCommit()
 {
     qDebug() << "commit";
+    _q_publishWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextPreferredLanguage(const char *language)
@@ -1353,20 +1782,154 @@ void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextPre
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextMaxTextLength(uint32_t maxLength)
 {
-    Q_Q(MInputContextWestonIMProtocolConnection);
-
     qDebug() << "maxLength:" << maxLength;
-    state_info[MaxTextLengthAttribute] = maxLength;
-    q->updateWidgetInformation(connection_id, state_info, false);
+    if (maxLength > INT_MAX) {
+        qWarning() << "This conversion from unsigned int to int may result in data lost, because the value exceeds INT_MAX. Before: " << maxLength << ", After: " << INT_MAX;
+        maxLength = INT_MAX;
+    }
+    state_info.setMaxTextLength(maxLength);
+    stageWidgetState();
 }
 
 void MInputContextWestonIMProtocolConnectionPrivate::handleInputMethodContextPlatformData(const char *pattern)
+{
+    qDebug() << "pattern:" << pattern;
+    state_info.setPlatformData(QString::fromUtf8(pattern));
+    stageWidgetState();
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::queueRequest(OutputRequest::Type type,
+                                                                  uint32_t arg0, uint32_t arg1,
+                                                                  uint32_t arg2, uint32_t arg3,
+                                                                  const QByteArray &text)
+{
+    OutputRequest request;
+    request.type = type;
+    request.serial = im_serial;
+    request.args[0] = arg0;
+    request.args[1] = arg1;
+    request.args[2] = arg2;
+    request.args[3] = arg3;
+    request.text = text;
+    request.preeditWasActive = preedit_active;
+
+    pending_requests.append(request);
+    flush_timer.start();
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::queuePreeditString(const QByteArray &text, bool force)
+{
+    if (text.isEmpty() && !preedit_active && !force) {
+        // Nothing to clear
+        return;
+    }
+    queueRequest(OutputRequest::PreeditString, 0, 0, 0, 0, text);
+    preedit_active = !text.isEmpty();
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::dropPendingPreedit()
+{
+    // Styling and cursor only apply to the following preedit string, so a
+    // queued preedit that has not been followed by a commit, a cursor change
+    // or a key event yet is replaced as a whole by a newer preedit or commit.
+    // Queued surrounding text deletions are kept.
+    for (int i = pending_requests.size() - 1; i >= 0; --i) {
+        const OutputRequest &request = pending_requests.at(i);
+
+        switch (request.type) {
+        case OutputRequest::PreeditStyling:
+        case OutputRequest::PreeditCursor:
+            pending_requests.remove(i);
+            break;
+        case OutputRequest::PreeditString:
+            preedit_active = request.preeditWasActive;
+            pending_requests.remove(i);
+            break;
+        case OutputRequest::DeleteSurroundingText:
+            break;
+        default:
+            return;
+        }
+    }
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::_q_flushRequests()
+{
+    flush_timer.stop();
+
+    if (pending_requests.isEmpty()) {
+        return;
+    }
+    if (!im_context) {
+        pending_requests.clear();
+        return;
+    }
+
+    Q_FOREACH (const OutputRequest &request, pending_requests) {
+        switch (request.type) {
+        case OutputRequest::DeleteSurroundingText:
+            input_method_context_delete_surrounding_text(im_context, request.serial,
+                                                         request.args[0], request.args[1]);
+            break;
+        case OutputRequest::PreeditStyling:
+            input_method_context_preedit_styling(im_context, request.serial,
+                                                 request.args[0], request.args[1],
+                                                 request.args[2]);
+            break;
+        case OutputRequest::PreeditCursor:
+            input_method_context_preedit_cursor(im_context, request.serial, request.args[0]);
+            break;
+        case OutputRequest::PreeditString:
+            input_method_context_preedit_string(im_context, request.serial,
+                                                request.text.constData(), request.text.constData());
+            break;
+        case OutputRequest::CursorPosition:
+            input_method_context_cursor_position(im_context, request.serial,
+                                                 request.args[0], request.args[1]);
+            break;
+        case OutputRequest::CommitString:
+            input_method_context_commit_string(im_context, request.serial, request.text.constData());
+            break;
+        case OutputRequest::Keysym:
+            input_method_context_keysym(im_context, request.serial, request.args[0],
+                                        request.args[1], request.args[2], request.args[3]);
+            break;
+        }
+    }
+    pending_requests.clear();
+
+    if (display) {
+        wl_display_flush(display);
+    }
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::stageWidgetState()
+{
+    state_staged = true;
+    publish_timer.start();
+}
+
+void MInputContextWestonIMProtocolConnectionPrivate::_q_publishWidgetState()
 {
     Q_Q(MInputContextWestonIMProtocolConnection);
 
-    qDebug() << "pattern:" << pattern;
-    state_info[PlatformDataAttribute] = pattern;
-    q->updateWidgetInformation(connection_id, state_info, false);
+    publish_timer.stop();
+
+    if (!state_staged) {
+        return;
+    }
+
+    const bool focusChanged = focus_change_staged;
+    const bool activated = activation_staged;
+    state_staged = false;
+    focus_change_staged = false;
+    activation_staged = false;
+
+    q->updateWidgetInformation(connection_id, state_info, focusChanged);
+    if (activated) {
+        q->activateContext(connection_id);
+        q->showInputMethod(connection_id);
+    }
 }
 
 // MInputContextWestonIMProtocolConnection
@@ -1387,6 +1950,13 @@ void MInputContextWestonIMProtocolConnection::setDisplayId(int displayId)
     d->setDisplayId(displayId);
 }
 
+int MInputContextWestonIMProtocolConnection::displayId() const
+{
+    Q_D(const MInputContextWestonIMProtocolConnection);
+
+    return d->m_displayId;
+}
+
 void MInputContextWestonIMProtocolConnection::sendPreeditString(const QString &string,
                                                                 const QList<Maliit::PreeditTextFormat> &preedit_formats,
                                                                 int replace_start,
@@ -1406,18 +1976,21 @@ void MInputContextWestonIMProtocolConnection::sendPreeditString(const QString &s
                                                    cursor_pos);
         const QByteArray raw(string.toUtf8());
 
+        d->dropPendingPreedit();
         if (replace_length > 0) {
-            input_method_context_delete_surrounding_text(d->im_context, d->im_serial,
-                                                         replace_start, replace_length);
+            d->queueRequest(OutputRequest::DeleteSurroundingText, replace_start, replace_length);
+        }
+        if (raw.isEmpty() && !d->preedit_active && replace_length <= 0) {
+            // No preedit to clear and no deletion to carry
+            return;
         }
         Q_FOREACH (const Maliit::PreeditTextFormat& format, preedit_formats) {
             if (format.start < 0 || format.length < 0) {
                 qWarning() << "This conversion from int to uint may result in data lost, because the value is less than 0. Before: " << format.start << ", " << format.length << ", After: " << 0;
                 return;
             }
-            input_method_context_preedit_styling(d->im_context, d->im_serial,
-                                                 format.start, format.length,
-                                                 face_to_uint (format.preeditFace));
+            d->queueRequest(OutputRequest::PreeditStyling, format.start, format.length,
+                            face_to_uint (format.preeditFace));
         }
         if (cursor_pos < 0) {
             if (string.size() > INT_MAX + cursor_pos) {
@@ -1426,84 +1999,16 @@ void MInputContextWestonIMProtocolConnection::sendPreeditString(const QString &s
             }
             cursor_pos = string.size() + 1 - cursor_pos;
         }
-        input_method_context_preedit_cursor(d->im_context, d->im_serial,
-                                            // convert from internal pos to byte pos
-                                            string.left(cursor_pos).toUtf8().size());
-        input_method_context_preedit_string(d->im_context, d->im_serial, raw.data(),
-                                            raw.data());
+        Utf8OffsetIndex offsets;
+        offsets.reset(raw);
+        d->queueRequest(OutputRequest::PreeditCursor,
+                        // convert from internal pos to byte pos
+                        offsets.byteOffset(cursor_pos));
+        // Always sent, as it carries the queued cursor and deletion
+        d->queuePreeditString(raw, true);
     }
 }
 
-int MInputContextWestonIMProtocolConnection::contentType(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    int type = MInputContextConnection::contentType(valid);
-    return type;
-}
-
-int MInputContextWestonIMProtocolConnection::enterKeyType(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    int type = MInputContextConnection::enterKeyType(valid);
-    return type;
-}
-
-bool MInputContextWestonIMProtocolConnection::surroundingText(QString &text, int &cursor_position)
-{
-    qDebug() << "text:" << text << "cursor_position:" << cursor_position;
-    bool result = MInputContextConnection::surroundingText(text, cursor_position);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::hasSelection(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::hasSelection(valid);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::focusState(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::focusState(valid);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::correctionEnabled(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::correctionEnabled(valid);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::predictionEnabled(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::predictionEnabled(valid);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::autoCapitalizationEnabled(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::autoCapitalizationEnabled(valid);
-    return result;
-}
-
-bool MInputContextWestonIMProtocolConnection::hiddenText(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::hiddenText(valid);
-    return result;
-}
-
-int MInputContextWestonIMProtocolConnection::anchorPosition(bool &valid)
-{
-    qDebug() << "valid:" << valid;
-    bool result = MInputContextConnection::anchorPosition(valid);
-    return result;
-}
-
 void MInputContextWestonIMProtocolConnection::sendCommitString(const QString &string,
                                                                int replace_start,
                                                                int replace_length,
@@ -1523,17 +2028,16 @@ void MInputContextWestonIMProtocolConnection::sendCommitString(const QString &st
         if (cursor_pos < 0) {
             cursor_pos = string.size();
         }
-        input_method_context_preedit_string(d->im_context, d->im_serial, "", "");
+        d->dropPendingPreedit();
+        d->queuePreeditString(QByteArray());
         // NOTE: length is unsigned in wayland protocol
         if (replace_length != 0) {
-            input_method_context_delete_surrounding_text(d->im_context, d->im_serial,
-                                                         replace_start, replace_length);
+            d->queueRequest(OutputRequest::DeleteSurroundingText, replace_start, replace_length);
         }
         const int pos = 0; // TODO (string.left(cursor_pos).toUtf8().size());
 
-        input_method_context_cursor_position (d->im_context, d->im_serial, pos, pos);
-        input_method_context_commit_string(d->im_context, d->im_serial, raw.data());
-                                           //string.left(cursor_pos).toUtf8().size());
+        d->queueRequest(OutputRequest::CursorPosition, pos, pos);
+        d->queueRequest(OutputRequest::CommitString, 0, 0, 0, 0, raw);
     }
 }
 
@@ -1581,8 +2085,8 @@ void MInputContextWestonIMProtocolConnection::sendKeyEvent(const QKeyEvent &keyE
             qWarning() << "This conversion from unsigned long to usigned int may result in data lost, because the value exceeds UINT_MAX. Before: " << timestamp << ", After: " << UINT_MAX;
             return;
         }
-        input_method_context_keysym(d->im_context, d->im_serial, (uint32_t) timestamp,
-                                    key_sym, state, mod_mask);
+        d->queueRequest(OutputRequest::Keysym, (uint32_t) timestamp,
+                        key_sym, state, mod_mask);
     }
 }
 
@@ -1599,11 +2103,13 @@ void MInputContextWestonIMProtocolConnection::setSelection(int start, int length
     Q_D (MInputContextWestonIMProtocolConnection);
 
     if (d->im_context) {
-        QString text(d->state_info[SurroundingTextAttribute].toString());
-        int byte_index(text.left(start).toUtf8().size());
-        int byte_length(text.mid(start, length).toUtf8().size());
+        const Utf8OffsetIndex &offsets(d->surrounding_text.offsets());
+        const int end = (length < 0 || start > INT_MAX - length) ? INT_MAX : start + length;
+        int byte_index(offsets.byteOffset(start));
+        int byte_length(offsets.byteOffset(end) - byte_index);
 
-        input_method_context_cursor_position (d->im_context, d->im_serial,
-                                              byte_index, byte_length);
+        d->queueRequest(OutputRequest::CursorPosition, byte_index, byte_length);
     }
 }
+
+#include "moc_minputcontextwestonimprotocolconnection.cpp"
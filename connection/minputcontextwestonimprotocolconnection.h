@@ -38,18 +38,10 @@ public:
     virtual ~MInputContextWestonIMProtocolConnection();
 
     void setDisplayId(int displayId);
-    virtual bool focusState(bool &valid);
-    virtual int contentType(bool &valid);
-    virtual int enterKeyType(bool &valid);
-    virtual bool correctionEnabled(bool &valid);
-    virtual bool predictionEnabled(bool &valid);
-    virtual bool autoCapitalizationEnabled(bool &valid);
-    virtual bool surroundingText(QString &text, int &cursor_position);
-    virtual bool hasSelection(bool &valid);
+    virtual int displayId() const;
 //    virtual int inputMethodMode(bool &valid);
 //    virtual QRect preeditRectangle(bool &valid);
 //    virtual QRect cursorRectangle(bool &valid);
-    virtual bool hiddenText(bool &valid);
     virtual void sendPreeditString(const QString &string,
                                    const QList<Maliit::PreeditTextFormat> &preedit_formats,
                                    int replacement_start = 0,
@@ -67,7 +59,6 @@ public:
 //    virtual void setDetectableAutoRepeat(bool enabled);
 //    virtual void setGlobalCorrectionEnabled(bool enabled);
     virtual void setSelection(int start, int length);
-    virtual int anchorPosition(bool &valid);
 //    virtual int preeditClickPos(bool &valid) const;
     virtual QString selection(bool &valid);
 
@@ -94,6 +85,9 @@ public:
 
 private:
     const QScopedPointer<MInputContextWestonIMProtocolConnectionPrivate> d_ptr;
+
+    Q_PRIVATE_SLOT(d_func(), void _q_flushRequests())
+    Q_PRIVATE_SLOT(d_func(), void _q_publishWidgetState())
 };
 //! \internal_end
 
@@ -0,0 +1,169 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "utf8offsetindex.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QtAlgorithms>
+
+namespace {
+
+const int Stride = 64;
+
+const quint64 HighBits = Q_UINT64_C(0x8080808080808080);
+
+inline bool isContinuationByte(unsigned char byte)
+{
+    return (byte & 0xC0) == 0x80;
+}
+
+inline int sequenceUtf16Length(unsigned char lead)
+{
+    // 4-byte sequences end up as surrogate pairs
+    return (lead & 0xF8) == 0xF0 ? 2 : 1;
+}
+
+} // unnamed namespace
+
+Utf8OffsetIndex::Utf8OffsetIndex()
+    : m_utf8(),
+      m_checkpoints(),
+      m_utf16Length(0)
+{
+}
+
+void Utf8OffsetIndex::reset(const QByteArray &utf8)
+{
+    m_utf8 = utf8;
+    m_checkpoints.clear();
+
+    const char *data = m_utf8.constData();
+    const int length = m_utf8.size();
+    int units = 0;
+    int position = 0;
+
+    if (length >= Stride) {
+        m_checkpoints.reserve(length / Stride);
+    }
+    for (; position + Stride <= length; position += Stride) {
+        units += countUtf16(data + position, Stride);
+        m_checkpoints.append(units);
+    }
+    m_utf16Length = units + countUtf16(data + position, length - position);
+}
+
+void Utf8OffsetIndex::clear()
+{
+    m_utf8.clear();
+    m_checkpoints.clear();
+    m_utf16Length = 0;
+}
+
+int Utf8OffsetIndex::utf16Offset(int byteOffset) const
+{
+    if (byteOffset <= 0) {
+        return 0;
+    }
+    if (byteOffset >= m_utf8.size()) {
+        return m_utf16Length;
+    }
+
+    const int checkpoint = byteOffset / Stride;
+    const int start = checkpoint * Stride;
+    const int units = checkpoint > 0 ? m_checkpoints.at(checkpoint - 1) : 0;
+
+    return units + countUtf16(m_utf8.constData() + start, byteOffset - start);
+}
+
+int Utf8OffsetIndex::byteOffset(int utf16Offset) const
+{
+    if (utf16Offset <= 0) {
+        return 0;
+    }
+    if (utf16Offset >= m_utf16Length) {
+        return m_utf8.size();
+    }
+
+    // Last checkpoint not past the requested offset
+    const int checkpoint = std::upper_bound(m_checkpoints.constBegin(), m_checkpoints.constEnd(), utf16Offset)
+                           - m_checkpoints.constBegin();
+    const unsigned char *data = reinterpret_cast<const unsigned char *>(m_utf8.constData());
+    const int length = m_utf8.size();
+    int position = checkpoint * Stride;
+    int units = checkpoint > 0 ? m_checkpoints.at(checkpoint - 1) : 0;
+
+    // Continuation bytes at the checkpoint belong to an already counted character
+    while (position < length && isContinuationByte(data[position])) {
+        ++position;
+    }
+    while (position < length) {
+        const int next = units + sequenceUtf16Length(data[position]);
+        if (next > utf16Offset) {
+            break;
+        }
+        units = next;
+        ++position;
+        while (position < length && isContinuationByte(data[position])) {
+            ++position;
+        }
+    }
+
+    return position;
+}
+
+int Utf8OffsetIndex::utf16Length() const
+{
+    return m_utf16Length;
+}
+
+int Utf8OffsetIndex::byteLength() const
+{
+    return m_utf8.size();
+}
+
+int Utf8OffsetIndex::countUtf16(const char *text, int length)
+{
+    int units = length;
+    int position = 0;
+
+    // Eight bytes at a time: every byte counts as one code unit, except
+    // continuation bytes (10xxxxxx), which count as none, and 4-byte lead
+    // bytes (11110xxx), which count as two.
+    for (; position + 8 <= length; position += 8) {
+        quint64 word;
+        memcpy(&word, text + position, sizeof(word));
+
+        const quint64 continuation = word & ~(word << 1) & HighBits;
+        const quint64 fourByteLead = word & (word << 1) & (word << 2) & (word << 3)
+                                     & ~(word << 4) & HighBits;
+
+        units += int(qPopulationCount(fourByteLead)) - int(qPopulationCount(continuation));
+    }
+    for (; position < length; ++position) {
+        const unsigned char byte = static_cast<unsigned char>(text[position]);
+        if (isContinuationByte(byte)) {
+            --units;
+        } else if (sequenceUtf16Length(byte) == 2) {
+            ++units;
+        }
+    }
+
+    return units;
+}
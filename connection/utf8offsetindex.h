@@ -0,0 +1,75 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef UTF8OFFSETINDEX_H
+#define UTF8OFFSETINDEX_H
+
+#include <QByteArray>
+#include <QVector>
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief Maps offsets between a UTF-8 buffer and its UTF-16 (QString) form.
+ *
+ * Wayland text protocols address text in UTF-8 bytes while Maliit uses QString
+ * indices. The index keeps the UTF-16 offset of every Stride-th byte, so that a
+ * lookup in either direction only has to count the code units of at most
+ * Stride bytes. Lookups neither decode nor allocate.
+ */
+class Utf8OffsetIndex
+{
+public:
+    Utf8OffsetIndex();
+
+    /*!
+     * \brief Rebuilds the index for the given UTF-8 text.
+     * \param utf8 Text, shared with the caller
+     */
+    void reset(const QByteArray &utf8);
+
+    //! Clears the index.
+    void clear();
+
+    //! Returns the UTF-16 offset of the given byte offset, clamped to the text.
+    int utf16Offset(int byteOffset) const;
+
+    /*!
+     * \brief Returns the byte offset of the given UTF-16 offset, clamped to the text.
+     *
+     * An offset pointing into a surrogate pair maps to the start of the pair.
+     */
+    int byteOffset(int utf16Offset) const;
+
+    //! Returns length of the text in UTF-16 code units.
+    int utf16Length() const;
+
+    //! Returns length of the text in bytes.
+    int byteLength() const;
+
+    //! Returns number of UTF-16 code units needed for the given UTF-8 bytes.
+    static int countUtf16(const char *text, int length);
+
+private:
+    QByteArray m_utf8;
+    // UTF-16 offset of byte (i + 1) * Stride
+    QVector<int> m_checkpoints;
+    int m_utf16Length;
+};
+//! \internal_end
+
+#endif // UTF8OFFSETINDEX_H
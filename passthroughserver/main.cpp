@@ -18,6 +18,7 @@
 #include "mimserver.h"
 #include "mimserveroptions.h"
 #include "mimglobalsettings.h"
+#include "mimprocessinfo.h"
 #ifdef HAVE_WAYLAND
 #include "waylandplatform.h"
 #endif // HAVE_WAYLAND
@@ -27,6 +28,7 @@
 #endif
 
 #include <QGuiApplication>
+#include <QTimer>
 #include <QtDebug>
 
 namespace {
@@ -188,20 +190,38 @@ int main(int argc, char **argv)
 
     QGuiApplication app(argc, argv);
 
-    // Input Context Connection
-    QSharedPointer<MInputContextConnection> icConnection(createConnection(connectionOptions));
-
-    if (icConnection.isNull()) {
-        qCritical("Unable to create connection, aborting.");
-        return 1;
+    QList<int> displayIds(connectionOptions.displayIds);
+    if (displayIds.isEmpty()) {
+        displayIds.append(connectionOptions.instanceId);
     }
 
     QSharedPointer<Maliit::AbstractPlatform> platform(createPlatform());
-
-    // The actual server
     MImServer::configureSettings(MImServer::PersistentSettings);
-    MImServer imServer(icConnection, platform);
-    Q_UNUSED(imServer);
+
+    // One connection and server per display; the platform, the loaded plugin
+    // libraries and the compiled keymaps are shared by all of them.
+    QList<QSharedPointer<MImServer> > servers;
+    Q_FOREACH (int displayId, displayIds) {
+        // Input Context Connection
+        QSharedPointer<MInputContextConnection> icConnection(createConnection(connectionOptions));
+
+        if (icConnection.isNull()) {
+            qCritical("Unable to create connection, aborting.");
+            return 1;
+        }
+        icConnection->setDisplayId(displayId);
+
+        // The actual server
+        servers.append(QSharedPointer<MImServer>(new MImServer(icConnection, platform)));
+        qInfo() << "MaliitServer: Serving display" << displayId;
+    }
+
+    // Lets the memory of one process serving N displays be compared with
+    // the sum over N single display processes
+    const int displayCount = displayIds.size();
+    QTimer::singleShot(0, [displayCount]() {
+        qInfo() << "MaliitServer: Started for" << displayCount << "display(s), RSS" << MImProcessInfo::residentSetSize() << "kB";
+    });
 
     int ret = 1;
 
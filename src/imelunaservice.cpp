@@ -109,17 +109,72 @@ protected:
 } // namespace
 
 IMELunaService::IMELunaService(QSharedPointer<MInputContextConnection> connection)
-    : m_connection(connection)
+    : m_primaryDisplayId(displayIdOf(connection.data()))
     , m_mainLoop(NULL)
     , m_handle(NULL)
-    , m_focusChangedSinceLastBroadcast(false)
     , m_broadcastTimer(new QTimer(this))
 {
     startService();
 
-    connect(m_connection.data(), &MInputContextConnection::widgetStateChanged, this, &IMELunaService::onWidgetStateChanged);
-    connect(m_connection.data(), &MInputContextConnection::resetInputMethodRequest, this, &IMELunaService::onReset);
+    m_broadcastTimer->setSingleShot(true);
     connect(m_broadcastTimer, &QTimer::timeout, this, &IMELunaService::broadcastWidgetState);
+
+    addConnection(connection);
+}
+
+void IMELunaService::addConnection(QSharedPointer<MInputContextConnection> connection)
+{
+    const int displayId = displayIdOf(connection.data());
+    if (m_displays.contains(displayId)) {
+        qWarning() << "Display" << displayId << "is already served";
+        return;
+    }
+    m_displays[displayId].connection = connection;
+
+    connect(connection.data(), &MInputContextConnection::widgetStateChanged, this,
+            [this, displayId](unsigned int, const QMap<QString, QVariant> &,
+                              const QMap<QString, QVariant> &, bool focusChanged) {
+        onWidgetStateChanged(displayId, focusChanged);
+    });
+    connect(connection.data(), &MInputContextConnection::resetInputMethodRequest, this,
+            [this, displayId]() {
+        onReset(displayId);
+    });
+}
+
+int IMELunaService::displayIdOf(const MInputContextConnection *connection)
+{
+    const int displayId = connection->displayId();
+    return displayId >= 0 ? displayId : MImGlobalSettings::instance()->getInstanceId();
+}
+
+QString IMELunaService::displaySubscriberKey(int displayId)
+{
+    return QString("%1_%2").arg(SubscriberKey).arg(displayId);
+}
+
+IMELunaService::Display *IMELunaService::findDisplay(const QJsonObject &payload, QString *error)
+{
+    const QJsonValue displayIdParam = payload["displayId"];
+    if (displayIdParam.isDouble()) {
+        QMap<int, Display>::iterator display = m_displays.find(displayIdParam.toInt());
+        if (display == m_displays.end()) {
+            *error = QString("Unknown \"displayId\"");
+            return 0;
+        }
+        return &display.value();
+    } else if (!displayIdParam.isUndefined()) {
+        *error = QString("Invalid \"displayId\" parameter");
+        return 0;
+    }
+
+    for (QMap<int, Display>::iterator display = m_displays.begin(); display != m_displays.end(); ++display) {
+        bool valid = false;
+        if (display->connection->focusState(valid) && valid) {
+            return &display.value();
+        }
+    }
+    return &m_displays[m_primaryDisplayId];
 }
 
 IMELunaService::~IMELunaService()
@@ -141,47 +196,47 @@ bool IMELunaService::hasSubscribers() const
     return !m_clientByToken.isEmpty();
 }
 
-void IMELunaService::broadcastToSubscribers(QJsonObject response)
+void IMELunaService::broadcastToSubscribers(const QString &subscriberKey, QJsonObject response)
 {
     LSErrorWrapper err;
     QJsonDocument document(response);
 
-    if (!LSSubscriptionReply(m_handle, IMELunaService::SubscriberKey, document.toJson().constData(), err)) {
+    if (!LSSubscriptionReply(m_handle, subscriberKey.toLatin1().constData(), document.toJson().constData(), err)) {
         qWarning() << "failed to reply to LS2 message";
     }
 }
 
 // Returns a JSON object representing the current input widget state
-QJsonObject IMELunaService::getWidgetStateJson() const
+QJsonObject IMELunaService::getWidgetStateJson(MInputContextConnection *connection)
 {
     QJsonObject state;
     bool valid = false;
 
-    bool focusState = m_connection->focusState(valid);
+    bool focusState = connection->focusState(valid);
 
     if (valid) {
         state.insert("focus", focusState);
     }
 
-    bool correctionEnabled = m_connection->correctionEnabled(valid);
+    bool correctionEnabled = connection->correctionEnabled(valid);
 
     if (valid) {
         state.insert("correctionEnabled", correctionEnabled);
     }
 
-    bool predictionEnabled = m_connection->predictionEnabled(valid);
+    bool predictionEnabled = connection->predictionEnabled(valid);
 
     if (valid) {
         state.insert("predictionEnabled", predictionEnabled);
     }
 
-    bool autoCapitalizationEnabled = m_connection->autoCapitalizationEnabled(valid);
+    bool autoCapitalizationEnabled = connection->autoCapitalizationEnabled(valid);
 
     if (valid) {
         state.insert("autoCapitalizationEnabled", autoCapitalizationEnabled);
     }
 
-    bool hiddenText = m_connection->hiddenText(valid);
+    bool hiddenText = connection->hiddenText(valid);
 
     if (valid) {
         state.insert("hiddenText", hiddenText);
@@ -191,7 +246,7 @@ QJsonObject IMELunaService::getWidgetStateJson() const
     int cursorPosition = 0;
 
     // For security, only send minimal information about surrounding text
-    if (m_connection->surroundingText(surroundingText, cursorPosition)) {
+    if (connection->surroundingText(surroundingText, cursorPosition)) {
         state.insert("hasSurroundingText", !surroundingText.isEmpty());
 
         if (!hiddenText) {
@@ -200,13 +255,13 @@ QJsonObject IMELunaService::getWidgetStateJson() const
         }
     }
 
-    bool hasSelection = m_connection->hasSelection(valid);
+    bool hasSelection = connection->hasSelection(valid);
 
     if (valid && hasSelection) {
         state.insert("hasSelection", hasSelection);
 
         if (!hiddenText) {
-            int anchorPosition = m_connection->anchorPosition(valid);
+            int anchorPosition = connection->anchorPosition(valid);
 
             if (valid) {
                 state.insert("anchorPosition", anchorPosition);
@@ -214,7 +269,7 @@ QJsonObject IMELunaService::getWidgetStateJson() const
         }
     }
 
-    int contentTypeInt = m_connection->contentType(valid);
+    int contentTypeInt = connection->contentType(valid);
 
     if (valid) {
         QString contentType;
@@ -231,7 +286,7 @@ QJsonObject IMELunaService::getWidgetStateJson() const
         state.insert("contentType", contentType);
     }
 
-    int enterKeyTypeInt = m_connection->enterKeyType(valid);
+    int enterKeyTypeInt = connection->enterKeyType(valid);
 
     if (valid) {
         state.insert("enterKeyType", enterKeyTypeInt);
@@ -240,86 +295,94 @@ QJsonObject IMELunaService::getWidgetStateJson() const
     return state;
 }
 
-void IMELunaService::onWidgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
-                                         const QMap<QString, QVariant> &oldState, bool focusChanged)
+void IMELunaService::onWidgetStateChanged(int displayId, bool focusChanged)
 {
-    Q_UNUSED(clientId);
-    Q_UNUSED(oldState);
-    Q_UNUSED(newState);
-
     if (!m_handle) {
         return;
     }
 
+    Display &display = m_displays[displayId];
     if (focusChanged) {
-        m_focusChangedSinceLastBroadcast = true;
+        display.focusChangedSinceLastBroadcast = true;
     }
 
     if (hasSubscribers()) {
         // run when event queue is empty (OK if already queued; QTimer will reschedule)
-        m_broadcastTimer->setSingleShot(true);
+        display.broadcastPending = true;
         m_broadcastTimer->start(0);
     }
 }
 
 void IMELunaService::broadcastWidgetState()
 {
-    QJsonObject widgetState = getWidgetStateJson();
+    for (QMap<int, Display>::iterator i = m_displays.begin(); i != m_displays.end(); ++i) {
+        Display &display = i.value();
+        if (!display.broadcastPending) {
+            continue;
+        }
+        display.broadcastPending = false;
 
-    QJsonObject response;
-    response.insert("currentWidget", widgetState);
-    response.insert("focusChanged", m_focusChangedSinceLastBroadcast);
+        QJsonObject widgetState = getWidgetStateJson(display.connection.data());
 
-    // Broadcast if focus or widget changed
-    if (widgetState != m_lastWidgetState || m_focusChangedSinceLastBroadcast) {
-        broadcastToSubscribers(response);
-    }
+        QJsonObject response;
+        response.insert("currentWidget", widgetState);
+        response.insert("focusChanged", display.focusChangedSinceLastBroadcast);
+        response.insert("displayId", i.key());
+
+        // Broadcast if focus or widget changed, to the subscribers of this
+        // display and to those of all displays
+        if (widgetState != display.lastWidgetState || display.focusChangedSinceLastBroadcast) {
+            broadcastToSubscribers(displaySubscriberKey(i.key()), response);
+            broadcastToSubscribers(IMELunaService::SubscriberKey, response);
+        }
 
-    m_focusChangedSinceLastBroadcast = false;
-    m_lastWidgetState = widgetState;
+        display.focusChangedSinceLastBroadcast = false;
+        display.lastWidgetState = widgetState;
+    }
 }
 
-void IMELunaService::onReset()
+void IMELunaService::onReset(int displayId)
 {
-    m_focusChangedSinceLastBroadcast = true;
-    m_broadcastTimer->setSingleShot(true);
+    Display &display = m_displays[displayId];
+    display.focusChangedSinceLastBroadcast = true;
+    display.broadcastPending = true;
     m_broadcastTimer->start(0);
 }
 
 // Insert text at the current cursor position, replacing selected text (if any)
-void IMELunaService::insertText(const QString& text, bool replace, ssize_t length)
+void IMELunaService::insertText(MInputContextConnection *connection, const QString& text, bool replace, ssize_t length)
 {
     if (replace) {
         QString surroundingText;
         int cursorPos = 0;
 
         // Find out how much text to replace
-        m_connection->surroundingText(surroundingText, cursorPos);
+        connection->surroundingText(surroundingText, cursorPos);
 
         if (length >= 0) {
             // Replace some text
-            m_connection->sendCommitString(text, -length, length);
+            connection->sendCommitString(text, -length, length);
         } else {
             if (cursorPos == INT_MIN) {
                 qWarning() << "-cursorPos operation happens overflow. cursorPos: " << INT_MIN;
                 return;
             }
             // Replace all text
-            m_connection->sendCommitString(text, -cursorPos, surroundingText.length());
+            connection->sendCommitString(text, -cursorPos, surroundingText.length());
         }
     } else {
         // Insert text at current cursor position
-        m_connection->sendCommitString(text);
+        connection->sendCommitString(text);
     }
 }
 
 // Delete characters at the current cursor position, or all selected text (if any)
-void IMELunaService::deleteCharacters(int numChars, DeleteMode mode)
+void IMELunaService::deleteCharacters(MInputContextConnection *connection, int numChars, DeleteMode mode)
 {
     QString surroundingText;
     int cursorPos = 0;
 
-    m_connection->surroundingText(surroundingText, cursorPos);
+    connection->surroundingText(surroundingText, cursorPos);
 
     if (mode == DirectMode) {
         // Generally less reliable in practice but more consistent
@@ -328,11 +391,11 @@ void IMELunaService::deleteCharacters(int numChars, DeleteMode mode)
             qWarning() << "-numChars operation happens overflow. numChars: " << INT_MIN;
             return;
         } else {
-            m_connection->sendCommitString("", -numChars, numChars);
+            connection->sendCommitString("", -numChars, numChars);
         }
     } else {
         bool valid = false;
-        bool hasSelection = m_connection->hasSelection(valid);
+        bool hasSelection = connection->hasSelection(valid);
 
         if (hasSelection && valid) {
             // only hit delete once if there's a selection
@@ -344,16 +407,16 @@ void IMELunaService::deleteCharacters(int numChars, DeleteMode mode)
         // doesn't seem to calculate the number of bytes to replace correctly yet
 
         for (int i = 0; i < numChars; i++) {
-            m_connection->sendKeyEvent( QKeyEvent(QEvent::KeyPress, Qt::Key_Backspace, Qt::NoModifier) );
-            m_connection->sendKeyEvent( QKeyEvent(QEvent::KeyRelease, Qt::Key_Backspace, Qt::NoModifier) );
+            connection->sendKeyEvent( QKeyEvent(QEvent::KeyPress, Qt::Key_Backspace, Qt::NoModifier) );
+            connection->sendKeyEvent( QKeyEvent(QEvent::KeyRelease, Qt::Key_Backspace, Qt::NoModifier) );
         }
     }
 }
 
-void IMELunaService::sendEnterKey()
+void IMELunaService::sendEnterKey(MInputContextConnection *connection)
 {
     QKeyEvent keyEvent(QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier);
-    m_connection->sendKeyEvent(keyEvent);
+    connection->sendKeyEvent(keyEvent);
 }
 
 extern "C" {
@@ -369,15 +432,19 @@ extern "C" {
  *
  * Parameters:
  *   subscribe - boolean (required). Must be true.
+ *   displayId - number (optional). Only receive updates of this display;
+ *               otherwise updates of all displays are received.
  *
  * Return payload:
  *   subscribed - boolean (required)
+ *   displayId - number (required)
  *   returnValue - boolean (required)
  *   errorCode - boolean (optional)
  *   errorText - boolean (optional)
  *
  * Subscription update payload:
  *   focusChanged - boolean (required)
+ *   displayId - number (required)
  *   currentWidget - object (optional)
  *     focus - boolean (optional)
  *     correctionEnabled - boolean (optional)
@@ -400,8 +467,19 @@ bool IMELunaService::handleRegisterRemoteKeyboard(LSHandle *handle, LSMessage *m
 
     LSMessageAdapter msg(message);
 
-    if (msg.isSubscription()) {
-        msg.addSubscription(IMELunaService::SubscriberKey);
+    QString error;
+    const QJsonObject payload = msg.getPayload();
+    Display *display = service->findDisplay(payload, &error);
+
+    if (!display) {
+        msg.replyError(error);
+    } else if (msg.isSubscription()) {
+        // Without a displayId, updates of all displays are received
+        if (payload["displayId"].isUndefined()) {
+            msg.addSubscription(IMELunaService::SubscriberKey);
+        } else {
+            msg.addSubscription(displaySubscriberKey(displayIdOf(display->connection.data())).toLatin1().constData());
+        }
 
         // Track subscription
         QString token = msg.uniqueToken();
@@ -417,10 +495,11 @@ bool IMELunaService::handleRegisterRemoteKeyboard(LSHandle *handle, LSMessage *m
         QJsonObject response;
         response.insert("subscribed", true);
 
-        QJsonObject state = service->getWidgetStateJson();
+        QJsonObject state = getWidgetStateJson(display->connection.data());
         if (!state.isEmpty()) {
             response.insert("currentWidget", state);
         }
+        response.insert("displayId", displayIdOf(display->connection.data()));
 
         msg.respond(response);
     } else {
@@ -448,6 +527,7 @@ bool IMELunaService::handleRegisterRemoteKeyboard(LSHandle *handle, LSMessage *m
  *   text - string (required). Text to insert.
  *   replace - boolean (optional). If true, replace any existing text in field.
  *   replaceLength - number of characters to replace
+ *   displayId - number (optional). Defaults to the focused display.
  *
  * Return payload:
  *   returnValue - boolean (required)
@@ -466,12 +546,17 @@ bool IMELunaService::handleInsertText(LSHandle *handle, LSMessage *message, void
     QJsonValue replaceParam = payload["replace"];
     QJsonValue replaceLengthParam = payload["replaceLength"];
 
-    if (textParam.isString()) {
+    QString error;
+    Display *display = service->findDisplay(payload, &error);
+
+    if (!display) {
+        msg.replyError(error);
+    } else if (textParam.isString()) {
         bool replace = replaceParam.isBool() ? replaceParam.toBool() : false;
         ssize_t length = replaceLengthParam.isDouble() ?
                          ((int) replaceLengthParam.toDouble(-1)) : -1;
 
-        service->insertText(textParam.toString(), replace, length);
+        insertText(display->connection.data(), textParam.toString(), replace, length);
         msg.replyTrue();
     } else {
         msg.replyError("Missing \"text\" parameter");
@@ -492,6 +577,7 @@ bool IMELunaService::handleInsertText(LSHandle *handle, LSMessage *message, void
  *   count - number (required). Number of characters to delete.
  *   mode - "backspace" (send backspace key)
  *          "direct" (remove characters directly from text string; single-line only)
+ *   displayId - number (optional). Defaults to the focused display.
  *
  * Return payload:
  *   returnValue - boolean (required)
@@ -524,8 +610,13 @@ bool IMELunaService::handleDeleteCharacters(LSHandle *handle, LSMessage *message
         }
     }
 
-    if (characterCount.isDouble() && characterCount.toDouble() > 0) {
-        service->deleteCharacters((int) characterCount.toDouble(), mode);
+    QString error;
+    Display *display = service->findDisplay(payload, &error);
+
+    if (!display) {
+        msg.replyError(error);
+    } else if (characterCount.isDouble() && characterCount.toDouble() > 0) {
+        deleteCharacters(display->connection.data(), (int) characterCount.toDouble(), mode);
         msg.replyTrue();
     } else {
         msg.replyError("Missing or invalid \"count\" parameter");
@@ -543,7 +634,7 @@ bool IMELunaService::handleDeleteCharacters(LSHandle *handle, LSMessage *message
  *   luna-send -n 1 palm://com.webos.service.ime/sendEnterKey '{}'
  *
  * Parameters:
- *   no parameters
+ *   displayId - number (optional). Defaults to the focused display.
  *
  * Return payload:
  *   returnValue - boolean (required)
@@ -557,7 +648,15 @@ bool IMELunaService::handleSendEnterKey(LSHandle *handle, LSMessage *message, vo
     IMELunaService *service = static_cast<IMELunaService *>(data);
     LSMessageAdapter msg(message);
 
-    service->sendEnterKey();
+    QString error;
+    Display *display = service->findDisplay(msg.getPayload(), &error);
+
+    if (!display) {
+        msg.replyError(error);
+        return true;
+    }
+
+    sendEnterKey(display->connection.data());
 
     msg.replyTrue();
     return true;
@@ -601,10 +700,9 @@ void IMELunaService::startService()
     bool ret;
     LSErrorWrapper err;
 
-    // TODO :
-    // Currently, only MaliitServer with instanceId 0 can serve an LS2 service.
     // instanceId 0 means 'primary service' with service name of com.webos.service.ime.
     // Other instances will have service name as com.webos.service.ime-n where n is the instanceId.
+    // Displays served by the same process share this service; see addConnection().
     ret = LSRegister(MImGlobalSettings::instance()->getServiceName().toLatin1().data(), &m_handle, err);
 
     qInfo() << "MaliitServer: Starting IMELunaService [" << MImGlobalSettings::instance()->getServiceName() << "], instance:" << MImGlobalSettings::instance()->getInstanceId();
@@ -22,6 +22,7 @@
 #include <QtCore>
 #include <QJsonObject>
 #include <QHash>
+#include <QMap>
 #include <QSharedPointer>
 #include "glib.h"
 #include "luna-service2/lunaservice.h"
@@ -41,24 +42,41 @@ public:
     explicit IMELunaService(QSharedPointer<MInputContextConnection> connection);
     virtual ~IMELunaService();
 
-protected Q_SLOTS:
-    void onWidgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
-                              const QMap<QString, QVariant> &oldState, bool focusChanged);
-
-    void onReset();
+    /*! Serves the display of \a connection too. Requests with a "displayId"
+     *  parameter go to the connection of that display.
+     */
+    void addConnection(QSharedPointer<MInputContextConnection> connection);
 
 protected:
     enum DeleteMode { BackspaceMode, DirectMode, MixedMode };
 
+    // Broadcast state of one served display
+    struct Display {
+        Display() : focusChangedSinceLastBroadcast(false), broadcastPending(false) {}
+
+        QSharedPointer<MInputContextConnection> connection;
+        bool focusChangedSinceLastBroadcast;
+        bool broadcastPending;
+        QJsonObject lastWidgetState;
+    };
+
+    void onWidgetStateChanged(int displayId, bool focusChanged);
+    void onReset(int displayId);
+
     void startService();
     void broadcastWidgetState();
-    void broadcastToSubscribers(QJsonObject response);
+    void broadcastToSubscribers(const QString &subscriberKey, QJsonObject response);
     bool hasSubscribers() const;
 
-    QJsonObject getWidgetStateJson() const;
-    void insertText(const QString& text, bool replace, ssize_t length = 0);
-    void deleteCharacters(int numChars, DeleteMode mode);
-    void sendEnterKey();
+    static int displayIdOf(const MInputContextConnection *connection);
+    static QString displaySubscriberKey(int displayId);
+    //! Returns the display requested by \a payload, else the focused one, else the first one
+    Display *findDisplay(const QJsonObject &payload, QString *error);
+
+    static QJsonObject getWidgetStateJson(MInputContextConnection *connection);
+    static void insertText(MInputContextConnection *connection, const QString& text, bool replace, ssize_t length = 0);
+    static void deleteCharacters(MInputContextConnection *connection, int numChars, DeleteMode mode);
+    static void sendEnterKey(MInputContextConnection *connection);
 
     static bool handleRegisterRemoteKeyboard(LSHandle *handle, LSMessage *message, void *data);
     static bool handleInsertText(LSHandle *handle, LSMessage *message, void *data);
@@ -71,12 +89,12 @@ protected:
 
     static const char *SubscriberKey;
 
-    QSharedPointer<MInputContextConnection> m_connection;
+    // By display id
+    QMap<int, Display> m_displays;
+    int m_primaryDisplayId;
     GMainLoop *m_mainLoop;
     LSHandle *m_handle;
 
-    bool m_focusChangedSinceLastBroadcast;
-    QJsonObject m_lastWidgetState;
     QTimer *m_broadcastTimer;
 
     QHash<QString, QSharedPointer<RemoteKeyboardClient> > m_clientByToken;
@@ -26,6 +26,7 @@ public:
     ~MAbstractInputMethodPrivate();
 
     MAbstractInputMethodHost *imHost;
+    QStringList interestingProperties;
 };
 
 
@@ -33,6 +34,7 @@ public:
 MAbstractInputMethodPrivate::MAbstractInputMethodPrivate(MAbstractInputMethodHost *imHost,
                                                          MAbstractInputMethod *parent)
     : imHost(imHost)
+    , interestingProperties()
 {
     Q_UNUSED(parent)
 }
@@ -192,3 +194,15 @@ bool MAbstractInputMethod::imExtensionEvent(MImExtensionEvent *event)
     Q_UNUSED(event);
     return false; // event not handled as default
 }
+
+void MAbstractInputMethod::setInterestingProperties(const QStringList &properties)
+{
+    Q_D(MAbstractInputMethod);
+    d->interestingProperties = properties;
+}
+
+QStringList MAbstractInputMethod::interestingProperties() const
+{
+    Q_D(const MAbstractInputMethod);
+    return d->interestingProperties;
+}
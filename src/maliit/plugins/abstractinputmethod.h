@@ -244,10 +244,35 @@ public:
      * the input method, allowing to add integration points between application and input method.
      * Reimplementing this method is optional.
      *
+     * MImExtensionEvent::Hibernate is sent when the server stays idle without
+     * quitting. Windows are released by the server; the input method should
+     * drop whatever it can rebuild, e.g. caches or pixmaps. MImExtensionEvent::WakeUp
+     * follows before the input method is used again.
+     *
+     * MImExtensionEvent::Prewarm is sent to an inactive input method next to
+     * the active one when pre-warming is enabled. It may prepare its layout so
+     * that a later switch only has to show it, but must keep its windows hidden.
+     *
      * \param event event to handle
      */
     virtual bool imExtensionEvent(MImExtensionEvent *event);
 
+    /*!
+     * \brief Declares the widget properties this input method reacts to.
+     *
+     * By default update() and imExtensionEvent() are called for every widget
+     * state change. Once a non-empty list is set, they are only called when
+     * one of \a properties changed, or when the focus changed. Property names
+     * are the keys used by MImUpdateEvent, e.g. "contentType" or
+     * "surroundingText". An empty list restores the default.
+     *
+     * \param properties names of the interesting widget properties.
+     */
+    void setInterestingProperties(const QStringList &properties);
+
+    //! Returns the properties set with setInterestingProperties().
+    QStringList interestingProperties() const;
+
 Q_SIGNALS:
     /*!
      * \brief Inform that active subview is changed to \a subViewId for \a state.
@@ -260,6 +285,14 @@ Q_SIGNALS:
     void activeSubViewChanged(const QString &subViewId,
                               Maliit::HandlerState state = Maliit::OnScreen);
 
+    /*!
+     * \brief Inform that the subviews returned by subViews() changed.
+     *
+     * The server caches subViews() of active input methods, so this must be
+     * emitted when they change while the input method is active.
+     */
+    void subViewsChanged();
+
 private:
     Q_DISABLE_COPY(MAbstractInputMethod)
     Q_DECLARE_PRIVATE(MAbstractInputMethod)
@@ -33,7 +33,10 @@ public:
     //! Defines valid types for input method extension event
     enum Type {
         None,
-        Update
+        Update,
+        Hibernate, //!< The server goes idle, caches should be dropped
+        WakeUp,    //!< The server is used again after Hibernate
+        Prewarm    //!< The inactive input method is likely switched to next
     };
 
     explicit MImExtensionEvent(Type type);
@@ -20,18 +20,59 @@
 #include <maliit/namespace.h>
 #include <maliit/namespaceinternal.h>
 
+#include <algorithm>
+
 MImUpdateEventPrivate::MImUpdateEventPrivate()
-    : update()
-    , changedProperties()
+    : state()
+    , changedFields(0)
+    , oldUpdate()
     , lastHints(Qt::ImhNone)
+    , update()
+    , updateValid(true)
+    , changedProperties()
+    , changedPropertiesValid(true)
+    , changedOtherProperties()
+    , changedOtherPropertiesValid(true)
 {}
 
 MImUpdateEventPrivate::MImUpdateEventPrivate(const QMap<QString, QVariant> &newUpdate,
                                              const QStringList &newChangedProperties,
                                              const Qt::InputMethodHints &newLastHints)
-    : update(newUpdate)
+    : state(MImWidgetState::fromMap(newUpdate))
+    , changedFields(0)
+    , oldUpdate()
+    , lastHints(newLastHints)
+    , update(newUpdate)
+    , updateValid(true)
     , changedProperties(newChangedProperties)
+    , changedPropertiesValid(true)
+    , changedOtherProperties()
+    , changedOtherPropertiesValid(true)
+{
+    Q_FOREACH (const QString &key, newChangedProperties) {
+        const MImWidgetState::Field field = MImWidgetState::fieldForName(key);
+
+        if (field == MImWidgetState::OtherAttributesField) {
+            changedOtherProperties.append(key);
+        }
+        changedFields |= MImWidgetState::fieldMask(field);
+    }
+}
+
+MImUpdateEventPrivate::MImUpdateEventPrivate(const MImWidgetState &newState,
+                                             MImWidgetState::Fields newChangedFields,
+                                             const QMap<QString, QVariant> &newOldUpdate,
+                                             const Qt::InputMethodHints &newLastHints)
+    : state(newState)
+    , changedFields(newChangedFields)
+    , oldUpdate(newOldUpdate)
     , lastHints(newLastHints)
+    , update()
+    , updateValid(false)
+    , changedProperties()
+    , changedPropertiesValid(false)
+    , changedOtherProperties()
+    , changedOtherPropertiesValid(false)
 {}
 
 bool MImUpdateEventPrivate::isFlagSet(Qt::InputMethodHint hint,
@@ -39,8 +80,11 @@ bool MImUpdateEventPrivate::isFlagSet(Qt::InputMethodHint hint,
 {
     bool result = false;
 
-    if (update.contains(Maliit::Internal::inputMethodHints)) {
-        long long int inputMethodHint = update.value(Maliit::Internal::inputMethodHints).toLongLong();
+    const QMap<QString, QVariant> &other(state.otherAttributes());
+    const QMap<QString, QVariant>::const_iterator hintsIter(other.constFind(Maliit::Internal::inputMethodHints));
+
+    if (hintsIter != other.constEnd()) {
+        long long int inputMethodHint = hintsIter.value().toLongLong();
         if (inputMethodHint < INT_MIN || inputMethodHint > INT_MAX) {
             qWarning() << "This conversion from long long int to int may result in data lost, because the value exceeds INT range. inputMethodHint: " << inputMethodHint;
             return false;
@@ -59,11 +103,45 @@ bool MImUpdateEventPrivate::isFlagSet(Qt::InputMethodHint hint,
 QVariant MImUpdateEventPrivate::extractProperty(const QString &key,
                                                 bool *changed) const
 {
+    const MImWidgetState::Field field = MImWidgetState::fieldForName(key);
+
+    if (field == MImWidgetState::OtherAttributesField) {
+        if (changed) {
+            *changed = otherPropertiesChanged().contains(key);
+        }
+        return state.otherAttributes().value(key);
+    }
+
     if (changed) {
-        *changed = changedProperties.contains(key);
+        *changed = isFieldChanged(field);
+    }
+    return state.value(field);
+}
+
+bool MImUpdateEventPrivate::isFieldChanged(MImWidgetState::Field field) const
+{
+    // Like propertiesChanged(), removed properties do not count as changed
+    return (changedFields & MImWidgetState::fieldMask(field)) && state.isValid(field);
+}
+
+const QStringList &MImUpdateEventPrivate::otherPropertiesChanged() const
+{
+    if (not changedOtherPropertiesValid) {
+        if (changedFields & MImWidgetState::fieldMask(MImWidgetState::OtherAttributesField)) {
+            const QMap<QString, QVariant> &other(state.otherAttributes());
+
+            for (QMap<QString, QVariant>::const_iterator iter = other.constBegin();
+                 iter != other.constEnd();
+                 ++iter) {
+                if (oldUpdate.value(iter.key()) != iter.value()) {
+                    changedOtherProperties.append(iter.key());
+                }
+            }
+        }
+        changedOtherPropertiesValid = true;
     }
 
-    return update.value(key);
+    return changedOtherProperties;
 }
 
 MImUpdateEvent::MImUpdateEvent(const QMap<QString, QVariant> &update,
@@ -79,18 +157,160 @@ MImUpdateEvent::MImUpdateEvent(const QMap<QString, QVariant> &update,
                         MImExtensionEvent::Update)
 {}
 
+MImUpdateEvent::MImUpdateEvent(const MImWidgetState &state,
+                               quint32 changedFields,
+                               const QMap<QString, QVariant> &oldUpdate,
+                               const Qt::InputMethodHints &lastHints)
+    : MImExtensionEvent(new MImUpdateEventPrivate(state, changedFields, oldUpdate, lastHints),
+                        MImExtensionEvent::Update)
+{}
+
 QVariant MImUpdateEvent::value(const QString &key) const
 {
     Q_D(const MImUpdateEvent);
-    return d->update.value(key);
+
+    if (d->updateValid) {
+        return d->update.value(key);
+    }
+    return d->extractProperty(key);
 }
 
 QStringList MImUpdateEvent::propertiesChanged() const
 {
     Q_D(const MImUpdateEvent);
+
+    if (not d->changedPropertiesValid) {
+        for (int field = 0; field < MImWidgetState::OtherAttributesField; ++field) {
+            if (d->isFieldChanged(static_cast<MImWidgetState::Field>(field))) {
+                d->changedProperties.append(QString::fromLatin1(
+                    MImWidgetState::fieldName(static_cast<MImWidgetState::Field>(field))));
+            }
+        }
+        d->changedProperties.append(d->otherPropertiesChanged());
+        // same order as the keys of the property map
+        std::sort(d->changedProperties.begin(), d->changedProperties.end());
+        d->changedPropertiesValid = true;
+    }
+
     return d->changedProperties;
 }
 
+bool MImUpdateEvent::isChanged(const QString &key) const
+{
+    Q_D(const MImUpdateEvent);
+    bool changed = false;
+    (void) d->extractProperty(key, &changed);
+    return changed;
+}
+
+int MImUpdateEvent::contentType(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::ContentTypeField);
+    }
+    return d->state.contentType();
+}
+
+int MImUpdateEvent::enterKeyType(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::EnterKeyTypeField);
+    }
+    return d->state.enterKeyType();
+}
+
+QString MImUpdateEvent::surroundingText(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::SurroundingTextField);
+    }
+    return d->state.surroundingText();
+}
+
+int MImUpdateEvent::cursorPosition(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::CursorPositionField);
+    }
+    return d->state.cursorPosition();
+}
+
+int MImUpdateEvent::anchorPosition(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::AnchorPositionField);
+    }
+    return d->state.anchorPosition();
+}
+
+bool MImUpdateEvent::hasSelection(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::HasSelectionField);
+    }
+    return d->state.hasSelection();
+}
+
+bool MImUpdateEvent::hiddenText(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::HiddenTextField);
+    }
+    return d->state.hiddenText();
+}
+
+bool MImUpdateEvent::correctionEnabled(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::CorrectionField);
+    }
+    return d->state.correctionEnabled();
+}
+
+bool MImUpdateEvent::predictionEnabled(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::PredictionField);
+    }
+    return d->state.predictionEnabled();
+}
+
+bool MImUpdateEvent::autoCapitalizationEnabled(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::AutoCapitalizationField);
+    }
+    return d->state.autoCapitalizationEnabled();
+}
+
+int MImUpdateEvent::maxTextLength(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::MaxTextLengthField);
+    }
+    return d->state.maxTextLength();
+}
+
+QRect MImUpdateEvent::cursorRectangle(bool *changed) const
+{
+    Q_D(const MImUpdateEvent);
+    if (changed) {
+        *changed = d->isFieldChanged(MImWidgetState::CursorRectangleField);
+    }
+    return d->state.cursorRectangle();
+}
+
 Qt::InputMethodHints MImUpdateEvent::hints(bool *changed) const
 {
     Q_D(const MImUpdateEvent);
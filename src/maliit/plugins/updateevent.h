@@ -22,6 +22,7 @@
 #include <QtCore>
 
 class MImUpdateEventPrivate;
+class MImWidgetState;
 
 /*! \ingroup pluginapi
  * \brief Monitor the input method properties sent by the application.
@@ -46,12 +47,76 @@ public:
                             const QStringList &propertiesChanged,
                             const Qt::InputMethodHints &lastHints);
 
+    //! \internal
+    //! C'tor used by the server.
+    //! \param state the typed widget state.
+    //! \param changedFields MImWidgetState::Fields mask of changed fields.
+    //! \param oldUpdate the previous property map, only used to find
+    //!        changed properties without a typed field.
+    //! \param lastHints the last input method hints.
+    explicit MImUpdateEvent(const MImWidgetState &state,
+                            quint32 changedFields,
+                            const QMap<QString, QVariant> &oldUpdate,
+                            const Qt::InputMethodHints &lastHints);
+    //! \internal_end
+
     //! Returns invalid QVariant if key is invalid.
     QVariant value(const QString &key) const;
 
     //! Returns list of keys that have changed, compared to last update event.
     QStringList propertiesChanged() const;
 
+    //! Returns whether property \a key changed with this event.
+    bool isChanged(const QString &key) const;
+
+    //! Returns the content type of the focus widget, see Maliit::TextContentType.
+    //! \param changed whether this value changed with this event.
+    int contentType(bool *changed = 0) const;
+
+    //! Returns the enter key type of the focus widget, see Maliit::EnterKeyType.
+    //! \param changed whether this value changed with this event.
+    int enterKeyType(bool *changed = 0) const;
+
+    //! Returns the text around the cursor.
+    //! \param changed whether this value changed with this event.
+    QString surroundingText(bool *changed = 0) const;
+
+    //! Returns the cursor position within surroundingText().
+    //! \param changed whether this value changed with this event.
+    int cursorPosition(bool *changed = 0) const;
+
+    //! Returns the selection anchor position within surroundingText().
+    //! \param changed whether this value changed with this event.
+    int anchorPosition(bool *changed = 0) const;
+
+    //! Returns whether the focus widget has selected text.
+    //! \param changed whether this value changed with this event.
+    bool hasSelection(bool *changed = 0) const;
+
+    //! Returns whether the focus widget hides its text, e.g. for passwords.
+    //! \param changed whether this value changed with this event.
+    bool hiddenText(bool *changed = 0) const;
+
+    //! Returns whether error correction is enabled for the focus widget.
+    //! \param changed whether this value changed with this event.
+    bool correctionEnabled(bool *changed = 0) const;
+
+    //! Returns whether word prediction is enabled for the focus widget.
+    //! \param changed whether this value changed with this event.
+    bool predictionEnabled(bool *changed = 0) const;
+
+    //! Returns whether auto-capitalization is enabled for the focus widget.
+    //! \param changed whether this value changed with this event.
+    bool autoCapitalizationEnabled(bool *changed = 0) const;
+
+    //! Returns the maximum text length of the focus widget, 0 if unlimited.
+    //! \param changed whether this value changed with this event.
+    int maxTextLength(bool *changed = 0) const;
+
+    //! Returns the cursor rectangle of the focus widget.
+    //! \param changed whether this value changed with this event.
+    QRect cursorRectangle(bool *changed = 0) const;
+
     //! Returns the focus widget's input method hints.
     //! \param changed whether this value changed with this event.
     Qt::InputMethodHints hints(bool *changed = 0) const;
@@ -17,27 +17,48 @@
 
 #include <maliit/plugins/extensionevent_p.h>
 
+#include "mimwidgetstate.h"
+
 #include <QtCore>
 
 class MImUpdateEventPrivate
     : public MImExtensionEventPrivate
 {
 public:
-    QMap<QString, QVariant> update;
-    QStringList changedProperties;
+    MImWidgetState state;
+    MImWidgetState::Fields changedFields;
+    // Previous properties, to diff attributes without a typed field
+    QMap<QString, QVariant> oldUpdate;
     Qt::InputMethodHints lastHints;
 
+    // Lazily built views for the string based API
+    mutable QMap<QString, QVariant> update;
+    mutable bool updateValid;
+    mutable QStringList changedProperties;
+    mutable bool changedPropertiesValid;
+    mutable QStringList changedOtherProperties;
+    mutable bool changedOtherPropertiesValid;
+
     explicit MImUpdateEventPrivate();
 
     explicit MImUpdateEventPrivate(const QMap<QString, QVariant> &newUpdate,
                                    const QStringList &newChangedProperties,
                                    const Qt::InputMethodHints &newLastHints);
 
+    explicit MImUpdateEventPrivate(const MImWidgetState &newState,
+                                   MImWidgetState::Fields newChangedFields,
+                                   const QMap<QString, QVariant> &newOldUpdate,
+                                   const Qt::InputMethodHints &newLastHints);
+
     bool isFlagSet(Qt::InputMethodHint hint,
                    bool *changed = 0) const;
 
     QVariant extractProperty(const QString &key,
                              bool *changed = 0) const;
+
+    bool isFieldChanged(MImWidgetState::Field field) const;
+
+    const QStringList &otherPropertiesChanged() const;
 };
 
 #endif // MIMUPDATEEVENT_P_H
@@ -32,11 +32,6 @@ namespace
     const char * const EnabledSubViews = MALIIT_CONFIG_ROOT"onscreen/enabled";
     const char * const ActiveSubView   = MALIIT_CONFIG_ROOT"onscreen/active";
 
-    bool equalPlugin(const MImOnScreenPlugins::SubView &subView, const QString &plugin)
-    {
-        return subView.plugin == plugin;
-    }
-
     bool notEqualPlugin(const MImOnScreenPlugins::SubView &subView, const QString &plugin)
     {
         return subView.plugin != plugin;
@@ -85,6 +80,11 @@ bool MImOnScreenPlugins::SubView::operator==(const MImOnScreenPlugins::SubView &
             && id == other.id);
 }
 
+uint qHash(const MImOnScreenPlugins::SubView &subView, uint seed)
+{
+    return qHash(subView.plugin, seed) ^ qHash(subView.id, seed);
+}
+
 MImOnScreenPlugins::MImOnScreenPlugins():
     QObject(),
     mAvailableSubViews(),
@@ -105,19 +105,12 @@ MImOnScreenPlugins::MImOnScreenPlugins():
 
 bool MImOnScreenPlugins::isEnabled(const QString &plugin) const
 {
-    QList<MImOnScreenPlugins::SubView> mEnabledAndAvailableSubViews;
-
-    std::remove_copy_if(mEnabledSubViews.begin(), mEnabledSubViews.end(),
-                        std::back_inserter(mEnabledAndAvailableSubViews),
-                        std::tr1::bind(&MImOnScreenPlugins::isSubViewUnavailable, this, _1));
-
-    return std::find_if(mEnabledAndAvailableSubViews.begin(), mEnabledAndAvailableSubViews.end(),
-                        std::tr1::bind(equalPlugin, _1, plugin)) != mEnabledAndAvailableSubViews.end();
+    return enabledPlugins.contains(plugin);
 }
 
 bool MImOnScreenPlugins::isSubViewEnabled(const SubView &subView) const
 {
-    return mEnabledSubViews.contains(subView);
+    return mEnabledSubViewSet.contains(subView);
 }
 
 QList<MImOnScreenPlugins::SubView> MImOnScreenPlugins::enabledSubViews() const
@@ -142,23 +135,38 @@ void MImOnScreenPlugins::setAutoEnabledSubViews(const QList<MImOnScreenPlugins::
 {
     // Update the enabled subviews list without saving the configuration to disk
     mEnabledSubViews = subViews;
+    updateLookups();
 }
 
 void MImOnScreenPlugins::updateAvailableSubViews(const QList<SubView> &availableSubViews)
 {
     mAvailableSubViews = availableSubViews;
+    updateLookups();
 
     autoDetectActiveSubView();
 }
 
 bool MImOnScreenPlugins::isSubViewAvailable(const SubView &subview) const
 {
-    return mAvailableSubViews.contains(subview);
+    return mAvailableSubViewSet.contains(subview);
 }
 
 bool MImOnScreenPlugins::isSubViewUnavailable(const SubView &subview) const
 {
-    return !mAvailableSubViews.contains(subview);
+    return !mAvailableSubViewSet.contains(subview);
+}
+
+void MImOnScreenPlugins::updateLookups()
+{
+    mAvailableSubViewSet = QSet<SubView>::fromList(mAvailableSubViews);
+    mEnabledSubViewSet = QSet<SubView>::fromList(mEnabledSubViews);
+
+    enabledPlugins.clear();
+    Q_FOREACH (const SubView &subView, mEnabledSubViews) {
+        if (mAvailableSubViewSet.contains(subView)) {
+            enabledPlugins.insert(subView.plugin);
+        }
+    }
 }
 
 void MImOnScreenPlugins::updateEnabledSubviews()
@@ -166,6 +174,7 @@ void MImOnScreenPlugins::updateEnabledSubviews()
     const QStringList &list = mEnabledSubViewsSettings.value().toStringList();
     const QList<SubView> oldEnabledSubviews = mEnabledSubViews;
     mEnabledSubViews = fromSettings(list);
+    updateLookups();
 
     // Changed subviews cause emission of enabledPluginsChanged() signal
     // because some subview from the setting might not really exists and therefore
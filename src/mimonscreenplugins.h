@@ -75,6 +75,7 @@ private Q_SLOTS:
 private:
     void autoDetectActiveSubView();
     void autoDetectEnabledSubViews();
+    void updateLookups();
 
 private:
     QList<SubView> mAvailableSubViews;
@@ -85,10 +86,15 @@ private:
     MImSettings mEnabledSubViewsSettings;
     MImSettings mActiveSubViewSettings;
 
-    QSet<QString> enabledPlugins; //should be updated when mEnabledSubViews is changed
+    // Lookup sets, updated by updateLookups() whenever the lists above change
+    QSet<SubView> mAvailableSubViewSet;
+    QSet<SubView> mEnabledSubViewSet;
+    QSet<QString> enabledPlugins; // plugins with an enabled and available subview
     bool mAllSubviewsEnabled;
 
 };
 
+uint qHash(const MImOnScreenPlugins::SubView &subView, uint seed = 0);
+
 Q_DECLARE_METATYPE(MImOnScreenPlugins::SubView)
 #endif // MIMENABLEDPLUGINS_H
@@ -0,0 +1,176 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "mimpluginindex.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <sys/stat.h>
+
+namespace {
+    const quint32 IndexMagic = 0x4d504958; // "MPIX"
+    const quint32 IndexVersion = 2;
+}
+
+// Found through argument dependent lookup by the QHash stream operators
+static QDataStream &operator<<(QDataStream &stream, const MImPluginIndex::Entry &entry)
+{
+    return stream << entry.modified << entry.size << entry.inode
+                  << entry.valid << qint32(entry.rejection) << entry.version << entry.hasSubViews
+                  << entry.subViewIds << entry.subViewTitles
+                  << entry.supportedStates << entry.loadTime;
+}
+
+static QDataStream &operator>>(QDataStream &stream, MImPluginIndex::Entry &entry)
+{
+    qint32 rejection = MImPluginIndex::NotRejected;
+    stream >> entry.modified >> entry.size >> entry.inode
+           >> entry.valid >> rejection >> entry.version >> entry.hasSubViews
+           >> entry.subViewIds >> entry.subViewTitles
+           >> entry.supportedStates >> entry.loadTime;
+    entry.rejection = static_cast<MImPluginIndex::Rejection>(rejection);
+    return stream;
+}
+
+MImPluginIndex::Entry::Entry()
+    : modified(0)
+    , size(0)
+    , inode(0)
+    , valid(false)
+    , rejection(MImPluginIndex::NotRejected)
+    , version()
+    , hasSubViews(false)
+    , subViewIds()
+    , subViewTitles()
+    , supportedStates()
+    , loadTime(0)
+{
+}
+
+MImPluginIndex::MImPluginIndex(const QString &fileName)
+    : m_fileName(fileName)
+    , m_entries()
+    , m_dirty(false)
+{
+}
+
+bool MImPluginIndex::load()
+{
+    m_entries.clear();
+    m_dirty = false;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != IndexMagic || version != IndexVersion) {
+        qWarning() << "Ignoring plugin index" << m_fileName << "with unknown format";
+        return false;
+    }
+
+    QHash<QString, Entry> entries;
+    stream >> entries;
+    if (stream.status() != QDataStream::Ok) {
+        qWarning() << "Ignoring corrupted plugin index" << m_fileName;
+        return false;
+    }
+
+    m_entries = entries;
+    return true;
+}
+
+bool MImPluginIndex::save()
+{
+    if (!m_dirty) {
+        return true;
+    }
+
+    // Drop entries of removed files
+    QHash<QString, Entry>::iterator iterator = m_entries.begin();
+    while (iterator != m_entries.end()) {
+        if (QFileInfo::exists(iterator.key())) {
+            ++iterator;
+        } else {
+            iterator = m_entries.erase(iterator);
+        }
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write plugin index" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << IndexMagic << IndexVersion << m_entries;
+
+    if (!file.commit()) {
+        qWarning() << "Failed to write plugin index" << m_fileName << file.errorString();
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool MImPluginIndex::stamp(const QString &path, Entry *entry)
+{
+    struct stat info;
+    if (::stat(QFile::encodeName(path).constData(), &info) != 0) {
+        return false;
+    }
+
+    entry->modified = static_cast<qint64>(info.st_mtim.tv_sec) * 1000
+                      + info.st_mtim.tv_nsec / 1000000;
+    entry->size = info.st_size;
+    entry->inode = info.st_ino;
+    return true;
+}
+
+const MImPluginIndex::Entry *MImPluginIndex::find(const QString &path, const Entry &current) const
+{
+    const QHash<QString, Entry>::const_iterator iterator = m_entries.constFind(path);
+    if (iterator == m_entries.constEnd()
+        || iterator->modified != current.modified
+        || iterator->size != current.size
+        || iterator->inode != current.inode) {
+        return 0;
+    }
+    return &iterator.value();
+}
+
+void MImPluginIndex::insert(const QString &path, const Entry &entry)
+{
+    m_entries.insert(path, entry);
+    m_dirty = true;
+}
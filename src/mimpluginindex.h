@@ -0,0 +1,91 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMPLUGININDEX_H
+#define MIMPLUGININDEX_H
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief On-disk record of the files found in the plugin directories.
+ *
+ * Entries are keyed by canonical path and stamped with the modification
+ * time, size and inode of the file. An entry is only returned while the
+ * file is unchanged, so edited or replaced files are probed again.
+ */
+class MImPluginIndex
+{
+public:
+    //! Why a file was rejected as plugin
+    enum Rejection {
+        NotRejected,
+        NotAPlugin,        //!< The metadata has no InputMethodPlugin IID
+        WrongInterface,    //!< The root instance is no InputMethodPlugin
+        NoSupportedStates,
+        LoadFailed         //!< dlopen or the root instance failed, may be transient
+    };
+
+    struct Entry {
+        Entry();
+
+        qint64 modified; // msecs since epoch
+        qint64 size;
+        quint64 inode;
+
+        //! False if the file was rejected as plugin
+        bool valid;
+        Rejection rejection;
+        QString version;
+        //! True if the metadata declares the OnScreen subviews
+        bool hasSubViews;
+        QStringList subViewIds;
+        QStringList subViewTitles;
+        QList<int> supportedStates;
+        //! Time spent loading the plugin, in milliseconds
+        qint64 loadTime;
+
+        //! True if the file is rejected for good while it is unchanged
+        bool isPermanentlyRejected() const { return !valid && rejection != LoadFailed; }
+    };
+
+    explicit MImPluginIndex(const QString &fileName);
+
+    //! Reads the index file. Returns false if it is missing or unreadable.
+    bool load();
+    //! Writes the index file if any entry changed since load().
+    bool save();
+
+    //! Stats \a path into the stamp fields of \a entry.
+    static bool stamp(const QString &path, Entry *entry);
+
+    //! Returns the entry of \a path if its stamp matches \a current.
+    const Entry *find(const QString &path, const Entry &current) const;
+    void insert(const QString &path, const Entry &entry);
+
+private:
+    QString m_fileName;
+    QHash<QString, Entry> m_entries;
+    bool m_dirty;
+};
+//! \internal_end
+
+#endif // MIMPLUGININDEX_H
@@ -25,11 +25,16 @@
 #include "mimsettings.h"
 #include "mimhwkeyboardtracker.h"
 #include <maliit/plugins/updateevent.h>
+#include <maliit/plugins/extensionevent.h>
 #include "mimsubviewoverride.h"
 #include "maliit/namespaceinternal.h"
 #include <maliit/settingdata.h>
 #include "windowgroup.h"
 #include "webosloginfo.h"
+#include "mimpluginindex.h"
+#include "mimserversnapshot.h"
+#include "mimprocessinfo.h"
+#include "config.h"
 
 #include <QDir>
 #include <QPluginLoader>
@@ -38,7 +43,12 @@
 #include <QCoreApplication>
 
 #include <QDebug>
+#include <QElapsedTimer>
+#include <QtConcurrent>
 #include <deque>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 namespace
 {
@@ -47,7 +57,6 @@ namespace
     const QString ChinesePluginLocation(MALIIT_PLUGINS_DIR "/CHN");
 
     const char * const VisualizationAttribute = "visualizationPriority";
-    const char * const FocusStateAttribute = "focusState";
 
     const QString ConfigRoot           = MALIIT_CONFIG_ROOT;
     const QString MImPluginPaths       = ConfigRoot + "paths";
@@ -56,22 +65,69 @@ namespace
     const QString PluginRoot           = MALIIT_CONFIG_ROOT"plugins";
     const QString PluginSettings       = MALIIT_CONFIG_ROOT"pluginsettings";
     const QString MImAccesoryEnabled   = MALIIT_CONFIG_ROOT"accessoryenabled";
+    const QString MImPrewarmNeighbours = MALIIT_CONFIG_ROOT"prewarmneighbours";
+    const QString MImStallThreshold    = MALIIT_CONFIG_ROOT"stallthreshold";
+    const int DefaultStallThreshold = 50; // ms
 
     const char * const InputMethodItem = "inputMethod";
     const char * const LoadAll = "loadAll";
 
     const char * const FileLocaleInfo = "/var/luna/preferences/localeInfo";
+
+    const QString PluginIndexFile = QString(MALIIT_DATA_DIR) + "/plugin-index";
+    const QString ServerSnapshotFile = QString(MALIIT_DATA_DIR) + "/server-snapshot";
+
+    // Runs in the global thread pool, so it must not touch the manager
+    MIMPluginManagerPrivate::PluginFileInfo readPluginFileInfo(const MIMPluginManagerPrivate::PluginFileInfo &candidate)
+    {
+        MIMPluginManagerPrivate::PluginFileInfo info(candidate);
+        if (info.indexed) {
+            return info;
+        }
+
+        // Only reads the metadata section, the library is not loaded
+        const QJsonObject metaData = QPluginLoader(info.path).metaData();
+        info.isPlugin = (metaData.value("IID").toString()
+                         == QLatin1String(qobject_interface_iid<Maliit::Plugins::InputMethodPlugin *>()));
+
+        const QJsonObject pluginMetaData = metaData.value("MetaData").toObject();
+        info.version = pluginMetaData.value("version").toString();
+
+        // Optional: "subViews": [ { "id": "...", "title": "..." }, ... ]
+        const QJsonValue subViews = pluginMetaData.value("subViews");
+        if (subViews.isArray()) {
+            info.hasSubViews = true;
+            Q_FOREACH (const QJsonValue &value, subViews.toArray()) {
+                const QJsonObject object = value.toObject();
+                MAbstractInputMethod::MInputMethodSubView subView;
+                subView.subViewId = object.value("id").toString();
+                subView.subViewTitle = object.value("title").toString();
+                info.subViews.append(subView);
+            }
+        }
+
+        return info;
+    }
 }
 
+int MIMPluginManagerPrivate::managerCount = 0;
+int MIMPluginManagerPrivate::hibernatingManagers = 0;
+
 MIMPluginManagerPrivate::MIMPluginManagerPrivate(const QSharedPointer<MInputContextConnection> &connection,
                                                  const QSharedPointer<Maliit::AbstractPlatform> &platform,
                                                  MIMPluginManager *p)
     : parent(p),
       mICConnection(connection),
+      handlerConfMapper(0),
+      pluginPathsConf(0),
+      pluginDisabledConf(0),
       localeInfo(0),
       imAccessoryEnabledConf(0),
+      prewarmNeighboursConf(0),
+      stallThresholdConf(0),
       shutDownInterval(0),
       isStaticService(0),
+      hibernateEnabled(0),
       adaptor(nullptr),
       q_ptr(0),
       visible(false),
@@ -80,43 +136,188 @@ MIMPluginManagerPrivate::MIMPluginManagerPrivate(const QSharedPointer<MInputCont
       attributeExtensionManager(new MAttributeExtensionManager),
       sharedAttributeExtensionManager(new MSharedAttributeExtensionManager),
       m_platform(platform),
-      isClientConnected(false)
+      isClientConnected(false),
+      applicationWindow(0),
+      pluginIndex(PluginIndexFile),
+      snapshot(ServerSnapshotFile),
+      pluginScanPending(false),
+      hibernating(false)
 {
     inputSourceToNameMap[Maliit::Hardware] = "hardware";
     inputSourceToNameMap[Maliit::Accessory] = "accessory";
+
+    pluginIndex.load();
+    ++managerCount;
 }
 
 
 MIMPluginManagerPrivate::~MIMPluginManagerPrivate()
 {
+    if (hibernating) {
+        --hibernatingManagers;
+    }
+    --managerCount;
     qDeleteAll(handlerToPluginConfs);
+    delete pluginPathsConf;
+    delete pluginDisabledConf;
 }
 
-void MIMPluginManagerPrivate::loadPlugins(QStringList &pluginDirs)
+QList<MIMPluginManagerPrivate::PluginFileInfo>
+MIMPluginManagerPrivate::collectPluginFiles(const QStringList &pluginDirs)
 {
-    Q_Q(MIMPluginManager);
+    QList<PluginFileInfo> files;
 
-    QList<Maliit::Plugins::InputMethodPlugin *> effectivePlugins;
+    Q_FOREACH (const QString &pluginDir, pluginDirs) {
+        const QDir dir(pluginDir);
 
-    // Load plugins
-    Q_FOREACH (QString pluginDir, pluginDirs) {
-        QStringList pluginFiles;
+        Q_FOREACH (const QString &fileName, dir.entryList(QDir::Files)) {
+            if (blacklist.contains(fileName)) {
+                qWarning() << fileName << "is blacklisted by" << MImPluginDisabled;
+                continue;
+            }
 
-        const QDir &dir(pluginDir);
-        pluginFiles = dir.entryList(QDir::Files);
+            PluginFileInfo info;
+            info.fileName = fileName;
+            info.path = QFileInfo(dir, fileName).canonicalFilePath();
+            info.pluginDir = pluginDir;
+            info.isPlugin = false;
+            info.hasSubViews = false;
+            info.indexed = false;
+
+            if (blacklist.contains(info.path)) {
+                qWarning() << fileName << "is already known as not a valid plugin";
+                continue;
+            }
+
+            // Unchanged files are described by the index, files rejected
+            // before are skipped without loading them again.
+            info.stamped = MImPluginIndex::stamp(info.path, &info.indexEntry);
+            const MImPluginIndex::Entry *entry = info.stamped ? pluginIndex.find(info.path, info.indexEntry) : 0;
+            if (entry && entry->isPermanentlyRejected()) {
+                qWarning() << fileName << "is known as not a valid plugin from" << PluginIndexFile;
+                blacklist.append(info.path);
+                continue;
+            } else if (entry && !entry->valid) {
+                // Failures to load may depend on other files, try again
+                qWarning() << fileName << "failed to load before, probing it again";
+            } else if (entry) {
+                info.indexed = true;
+                info.isPlugin = true;
+                info.version = entry->version;
+                info.hasSubViews = entry->hasSubViews;
+                for (int i = 0; i < entry->subViewIds.size() && i < entry->subViewTitles.size(); ++i) {
+                    MAbstractInputMethod::MInputMethodSubView subView;
+                    subView.subViewId = entry->subViewIds.at(i);
+                    subView.subViewTitle = entry->subViewTitles.at(i);
+                    info.subViews.append(subView);
+                }
+            }
 
-        Q_FOREACH (const QString &fileName, pluginFiles) {
-            Maliit::Plugins::InputMethodPlugin *plugin = loadPlugin(dir, fileName);
-            if (plugin)
-                effectivePlugins.append(plugin);
+            files.append(info);
         } // end Q_FOREACH file in pluginDir
     } // end Q_FOREACH pluginDir in pluginDirs
 
+    return files;
+}
+
+QList<Maliit::Plugins::InputMethodPlugin *>
+MIMPluginManagerPrivate::loadPluginFiles(const QList<PluginFileInfo> &files,
+                                         bool deferUnconfigured)
+{
+    QList<Maliit::Plugins::InputMethodPlugin *> effectivePlugins;
+
+    // Input methods are created only for plugins which are configured
+    // for a handler, or whose subviews have to be queried.
+    const QSet<QString> configured = configuredPluginIds();
+
+    // The libraries of the other plugins are not even loaded yet, so the
+    // first keyboard only waits for its own plugin. This works without any
+    // index or metadata, on the first start after an install as well.
+    if (deferUnconfigured) {
+        bool anyConfigured = false;
+        Q_FOREACH (const PluginFileInfo &info, files) {
+            if (info.isPlugin && configured.contains(info.fileName)) {
+                anyConfigured = true;
+                break;
+            }
+        }
+        deferUnconfigured = anyConfigured;
+    }
+
+    Q_FOREACH (const PluginFileInfo &info, files) {
+        if (deferUnconfigured && info.isPlugin && !configured.contains(info.fileName)) {
+            deferredPluginFiles.append(info);
+            continue;
+        }
+
+        MImPluginIndex::Entry entry = info.indexEntry;
+
+        Maliit::Plugins::InputMethodPlugin *plugin = 0;
+        MImPluginIndex::Rejection rejection = MImPluginIndex::NotRejected;
+        if (!info.isPlugin) {
+            qWarning() << info.path << "is not a Maliit::Server::InputMethodPlugin (blacklisted)";
+            blacklist.append(info.path);
+            rejection = MImPluginIndex::NotAPlugin;
+        } else {
+            const bool createNow = !info.hasSubViews || configured.contains(info.fileName);
+            QElapsedTimer loadTimer;
+            loadTimer.start();
+            plugin = loadPlugin(info, createNow, &rejection);
+            entry.loadTime = loadTimer.elapsed();
+        }
+
+        if (plugin)
+            effectivePlugins.append(plugin);
+
+        // Only files probed now are recorded; a failure to create the input
+        // method does not blacklist the file and may not happen next time.
+        if (info.stamped && !info.indexed) {
+            entry.valid = info.isPlugin && !blacklist.contains(info.path);
+            entry.rejection = rejection;
+            entry.version = info.version;
+            entry.hasSubViews = info.hasSubViews;
+            Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subView, info.subViews) {
+                entry.subViewIds.append(subView.subViewId);
+                entry.subViewTitles.append(subView.subViewTitle);
+            }
+            if (plugin) {
+                Q_FOREACH (Maliit::HandlerState state, plugin->supportedStates()) {
+                    entry.supportedStates.append(state);
+                }
+            }
+            pluginIndex.insert(info.path, entry);
+        }
+    }
+    pluginIndex.save();
+
+    return effectivePlugins;
+}
+
+void MIMPluginManagerPrivate::loadPlugins(const QStringList &pluginDirs)
+{
+    Q_Q(MIMPluginManager);
+
+    // Read the metadata of all files in parallel, without loading them
+    const QList<PluginFileInfo> scanned
+        = QtConcurrent::blockingMapped(collectPluginFiles(pluginDirs), readPluginFileInfo);
+    finishDeferredPlugins();
+    const QList<Maliit::Plugins::InputMethodPlugin *> effectivePlugins = loadPluginFiles(scanned, true);
+
+    // The configured plugins failed, the others are needed now
+    if (plugins.empty() && !deferredPluginFiles.isEmpty()) {
+        finishDeferredPlugins();
+    }
+
     if (plugins.empty()) {
         qWarning("No plugins were loaded. Stopping");
         QCoreApplication::quit();
     }
 
+    if (!deferredPluginFiles.isEmpty()) {
+        qInfo() << "Deferred loading of" << deferredPluginFiles.size() << "unconfigured plugin files";
+        deferredPluginTimer.start();
+    }
+
     const QList<MImOnScreenPlugins::SubView> &availableSubViews = availablePluginsAndSubViews();
     onScreenPlugins.updateAvailableSubViews(availableSubViews);
 
@@ -129,25 +330,274 @@ void MIMPluginManagerPrivate::loadPlugins(QStringList &pluginDirs)
     Q_EMIT q->pluginsChanged();
 }
 
-Maliit::Plugins::InputMethodPlugin* MIMPluginManagerPrivate::loadPlugin(const QDir &dir, const QString &fileName)
+void MIMPluginManagerPrivate::addPluginDirs(const QStringList &pluginDirs, const QStringList &replacedDirs)
+{
+    finishPluginScan();
+
+    // Metadata is read off the GUI thread. Plugin instances are QObjects
+    // and are created in _q_pluginFilesScanned(), back in the GUI thread.
+    pluginScanPending = true;
+    pluginDirsToRemove = replacedDirs;
+    pluginScan.setFuture(QtConcurrent::mapped(collectPluginFiles(pluginDirs), readPluginFileInfo));
+}
+
+void MIMPluginManagerPrivate::finishDeferredPlugins()
+{
+    if (deferredPluginFiles.isEmpty()) {
+        return;
+    }
+
+    deferredPluginTimer.stop();
+    const QList<PluginFileInfo> files = deferredPluginFiles;
+    deferredPluginFiles.clear();
+    loadPluginFiles(files);
+    updateLoadedPlugins();
+}
+
+void MIMPluginManagerPrivate::_q_loadDeferredPlugin()
+{
+    if (deferredPluginFiles.isEmpty()) {
+        return;
+    }
+
+    loadPluginFiles(QList<PluginFileInfo>() << deferredPluginFiles.takeFirst());
+
+    if (deferredPluginFiles.isEmpty()) {
+        updateLoadedPlugins();
+    } else {
+        deferredPluginTimer.start();
+    }
+}
+
+void MIMPluginManagerPrivate::finishPluginScan()
+{
+    // Dir changes apply to the complete set of plugins
+    finishDeferredPlugins();
+
+    if (pluginScanPending) {
+        pluginScan.waitForFinished();
+        _q_pluginFilesScanned();
+    }
+}
+
+void MIMPluginManagerPrivate::_q_pluginFilesScanned()
+{
+    if (!pluginScanPending) {
+        return;
+    }
+    pluginScanPending = false;
+
+    if (!loadPluginFiles(pluginScan.future().results()).isEmpty()) {
+        updateLoadedPlugins();
+    }
+
+    // Dirs added again meanwhile are kept
+    QStringList removedDirs;
+    Q_FOREACH (const QString &dir, pluginDirsToRemove) {
+        if (!pluginDirs.contains(dir))
+            removedDirs.append(dir);
+    }
+    pluginDirsToRemove.clear();
+    if (!removedDirs.isEmpty()) {
+        removePluginDirs(removedDirs);
+    }
+}
+
+void MIMPluginManagerPrivate::removePluginDirs(const QStringList &pluginDirs)
+{
+    finishPluginScan();
+
+    bool removed = false;
+    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
+        if (!pluginDirs.contains(plugins.value(plugin).pluginDir)) {
+            continue;
+        }
+
+        unloadPlugin(plugin);
+        if (!plugins.contains(plugin)) {
+            removed = true;
+            Q_FOREACH (Maliit::HandlerState state, handlerToPlugin.keys(plugin)) {
+                handlerToPlugin.remove(state);
+            }
+        }
+    }
+
+    if (removed) {
+        updateLoadedPlugins();
+    }
+}
+
+QStringList MIMPluginManagerPrivate::localePluginDirs()
+{
+    QStringList pluginDirs = pluginPathsConf->value(QStringList(DefaultPluginLocation)).toStringList();
+    QStringList keyboards;
+    QJsonObject localeJson;
+
+    if (localeInfo && !localeInfo->value().isNull()) {
+        localeJson = QJsonObject::fromVariantMap(localeInfo->value().toMap());
+        qInfo() << "Read localeInfo from SettingsService or its last known value";
+    } else {
+        // Try the file cache
+        QFile file(FileLocaleInfo);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            localeJson = QJsonDocument::fromJson(file.readAll()).object()["localeInfo"].toObject();
+            qInfo() << "Read localeInfo from file" << FileLocaleInfo;
+            file.close();
+        }
+    }
+
+    if (!localeJson.isEmpty()) {
+        QString keyboardsLang = 0;
+        QJsonArray keyboardsArray = localeJson["keyboards"].toArray();
+
+        qDebug() << "keyboards in localeInfo:" << keyboardsArray;
+
+        if (!keyboardsArray.isEmpty()) {
+            for (ssize_t index = 0; index < keyboardsArray.size() ; ++index) {
+                if (!keyboardsArray[index].isNull()) {
+                    keyboardsLang = keyboardsArray[index].toString();
+                    keyboards.append(keyboardsLang);
+                    webOSLogInfo("VKB_LANGUAGE", "keyboardLang", keyboardsLang);
+                    if (keyboardsLang == "ja") {
+                        webOSLogInfo("VKB_JP_PLUGIN", "plugin", "Japan Plugin Loading");
+                        pluginDirs.push_back(JapanesePluginLocation);
+                    } else if (keyboardsLang == "zh" || keyboardsLang == "zh-Hans"
+                        || keyboardsLang == "zh-Hant") {
+                        webOSLogInfo("VKB_ZH_PLUGIN", "plugin", "China Plugin Loading");
+                        pluginDirs.push_back(ChinesePluginLocation);
+                    }
+                }
+            }
+        }
+    } else {
+        qWarning() << "localeInfo is unavailable, try to load all known plugins";
+        webOSLogInfo("VKB_JP_PLUGIN", "plugin", "Japan Plugin Loading");
+        pluginDirs.push_back(JapanesePluginLocation);
+        webOSLogInfo("VKB_ZH_PLUGIN", "plugin", "China Plugin Loading");
+        pluginDirs.push_back(ChinesePluginLocation);
+    }
+
+    pluginDirs.sort();
+
+    snapshot.setPluginDirs(pluginDirs);
+    snapshot.setKeyboards(keyboards);
+    snapshot.save();
+
+    return pluginDirs;
+}
+
+void MIMPluginManagerPrivate::hibernate()
+{
+    if (hibernating) {
+        return;
+    }
+
+    const long rss = MImProcessInfo::residentSetSize();
+    hibernating = true;
+    ++hibernatingManagers;
+
+    profiler.dump();
+    dumpSwitchStats();
+
+    MImExtensionEvent event(MImExtensionEvent::Hibernate);
+    for (Plugins::iterator i = plugins.begin(); i != plugins.end(); ++i) {
+        i->prewarmed = false;
+        if (i->inputMethod) {
+            MImPluginProfiler::Call call(profiler, i->inputMethod, MImPluginProfiler::ImExtensionEvent);
+            (void) i->inputMethod->imExtensionEvent(&event);
+        }
+        if (i->windowGroup) {
+            i->windowGroup->releaseWindows();
+        }
+    }
+
+    // Settings notifications are shared by the whole process, so they can
+    // only be dropped once the managers of all displays are hibernating
+    if (hibernatingManagers == managerCount) {
+        MImSettings::suspendNotifications();
+    }
+
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+
+    qWarning() << "Hibernated, RSS" << rss << "kB ->" << MImProcessInfo::residentSetSize() << "kB";
+    webOSLogInfo("HIBERNATE", "RSS", QString::number(MImProcessInfo::residentSetSize()));
+}
+
+void MIMPluginManagerPrivate::wakeUp()
+{
+    if (!hibernating) {
+        return;
+    }
+
+    QElapsedTimer wakeUpTimer;
+    wakeUpTimer.start();
+    hibernating = false;
+
+    if (hibernatingManagers-- == managerCount) {
+        MImSettings::resumeNotifications();
+    }
+
+    MImExtensionEvent event(MImExtensionEvent::WakeUp);
+    for (Plugins::iterator i = plugins.begin(); i != plugins.end(); ++i) {
+        if (i->windowGroup) {
+            i->windowGroup->restoreWindows();
+            if (applicationWindow) {
+                i->windowGroup->setApplicationWindow(applicationWindow);
+            }
+        }
+        if (i->inputMethod) {
+            MImPluginProfiler::Call call(profiler, i->inputMethod, MImPluginProfiler::ImExtensionEvent);
+            (void) i->inputMethod->imExtensionEvent(&event);
+        }
+    }
+
+    qWarning() << "Woke up in" << wakeUpTimer.elapsed() << "ms, RSS" << MImProcessInfo::residentSetSize() << "kB";
+    webOSLogInfo("WAKEUP", "RSS", QString::number(MImProcessInfo::residentSetSize()));
+}
+
+void MIMPluginManagerPrivate::updateLoadedPlugins()
 {
     Q_Q(MIMPluginManager);
 
-    if (blacklist.contains(fileName)) {
-        qWarning() << fileName << "is blacklisted by" << MImPluginDisabled;
-        return 0;
+    onScreenPlugins.updateAvailableSubViews(availablePluginsAndSubViews());
+
+    // Handlers left without a plugin get the configured one, if it is loaded now
+    InputSourceToNameMap::const_iterator end = inputSourceToNameMap.constEnd();
+    for (InputSourceToNameMap::const_iterator i(inputSourceToNameMap.constBegin()); i != end; ++i) {
+        if (handlerToPlugin.contains(i.key())) {
+            continue;
+        }
+        const QString pluginId = configuredPluginId(i.key());
+        if (!pluginId.isEmpty()) {
+            addHandlerMap(i.key(), pluginId);
+        }
     }
 
-    QFileInfo pluginInfo = QFileInfo(dir, fileName);
-    const QString pluginPath = pluginInfo.canonicalFilePath();
+    registerSettings();
 
-    if (blacklist.contains(pluginPath)) {
-        qWarning() << fileName << "is already known as not a valid plugin";
-        return 0;
+    Q_EMIT q->pluginsChanged();
+
+    // The active plugin and its window are left alone unless the on screen
+    // subview belongs to another plugin, or nothing is active anymore.
+    Maliit::Plugins::InputMethodPlugin *current = activePlugin(Maliit::OnScreen);
+    if (!current || !activePlugins.contains(current)
+        || plugins.value(current).pluginId != onScreenPlugins.activeSubView().plugin) {
+        _q_onScreenSubViewChanged();
     }
+    if (activePlugins.isEmpty()) {
+        q->updateInputSource();
+    }
+}
+
+Maliit::Plugins::InputMethodPlugin* MIMPluginManagerPrivate::loadPlugin(const PluginFileInfo &info, bool createNow,
+                                                                        MImPluginIndex::Rejection *rejection)
+{
+    Q_Q(MIMPluginManager);
 
+    const QString &pluginPath = info.path;
     Maliit::Plugins::InputMethodPlugin *plugin = 0;
-    QString pluginVersion("");
     QPluginLoader *loader = 0;
 
     loader = new QPluginLoader(pluginPath);
@@ -158,17 +608,23 @@ Maliit::Plugins::InputMethodPlugin* MIMPluginManagerPrivate::loadPlugin(const QD
 
     if (loader->isLoaded()) {
         plugin = qobject_cast<Maliit::Plugins::InputMethodPlugin *>(loader->instance());
-        qWarning() << pluginPath << "is already loaded in" << plugin;
-        delete loader;
-        return plugin;
+        if (plugins.contains(plugin)) {
+            qWarning() << pluginPath << "is already loaded in" << plugin;
+            delete loader;
+            return plugin;
+        }
+        // Loaded by the manager of another display in this process: share the
+        // library and its root instance, but create our own input method.
+        qDebug() << "Sharing file" << pluginPath << "loaded in" << plugin;
+    } else {
+        qDebug() << "Loading file" << pluginPath;
     }
 
-    qDebug() << "Loading file" << pluginPath;
-
     QObject *pluginInstance = loader->instance();
     if (!pluginInstance) {
         qWarning() << "Error loading file as plugin" << pluginPath << "with an error" << loader->errorString() << "(blacklisted)";
         blacklist.append(pluginPath);
+        *rejection = MImPluginIndex::LoadFailed;
         delete loader;
         return 0;
     }
@@ -177,53 +633,132 @@ Maliit::Plugins::InputMethodPlugin* MIMPluginManagerPrivate::loadPlugin(const QD
     if (!plugin) {
         qWarning() << pluginPath << "is not a Maliit::Server::InputMethodPlugin (blacklisted)";
         blacklist.append(pluginPath);
+        *rejection = MImPluginIndex::WrongInterface;
         delete loader;
         return 0;
     }
 
-    pluginVersion = loader->metaData().value("MetaData").toObject().value("version").toString();
-    pluginVersion.prepend("-");
-
-    if (plugin->supportedStates().isEmpty()) {
+    const PluginState supportedStates = plugin->supportedStates();
+    if (supportedStates.isEmpty()) {
         qWarning() << pluginPath << "is a plugin that does not support any state (blacklisted)";
         blacklist.append(pluginPath);
+        *rejection = MImPluginIndex::NoSupportedStates;
         delete loader;
         return 0;
     }
 
+    PluginDescription desc = { 0, 0, PluginState(),
+                               Maliit::SwitchUndefined, info.fileName, loader,
+                               QSharedPointer<Maliit::WindowGroup>(), info.subViews,
+                               info.pluginDir, supportedStates,
+                               QHash<Maliit::HandlerState, SubViews>(), false, false };
+
+    Plugins::iterator iterator = plugins.insert(plugin, desc);
+    availableSubViewsCache.clear();
+
+    // only keep valid plugin descriptions
+    if (createNow && !createInputMethod(iterator)) {
+        plugins.erase(iterator);
+        delete loader;
+        return 0;
+    }
+    // A plugin of the same id in a dir being replaced is unloaded later
+    pluginsById.insert(desc.pluginId, plugin);
+
+    webOSLogInfo("VKB_VERSION", "PLUGIN", plugin->name() + "-" + info.version);
+
+    Q_EMIT q->pluginLoaded();
+
+    qWarning() << pluginPath << "is loaded successfully in" << plugin
+               << (iterator->inputMethod ? "" : "(input method deferred)");
+
+    return plugin;
+}
+
+bool MIMPluginManagerPrivate::createInputMethod(Plugins::iterator iterator)
+{
+    Q_Q(MIMPluginManager);
+
+    PluginDescription &desc = iterator.value();
+    if (desc.inputMethod) {
+        return true;
+    }
+
+    Maliit::Plugins::InputMethodPlugin *plugin = iterator.key();
+
     QSharedPointer<Maliit::WindowGroup> windowGroup(new Maliit::WindowGroup(m_platform));
     MInputMethodHost *host = new MInputMethodHost(mICConnection, q, windowGroup,
-                                                  fileName, plugin->name());
+                                                  desc.pluginId, plugin->name());
 
     MAbstractInputMethod *im = plugin->createInputMethod(host);
 
     QObject::connect(q, SIGNAL(pluginsChanged()), host, SIGNAL(pluginsChanged()));
 
-    // only add valid plugin descriptions
     if (!im) {
-        qWarning() << "Creation of InputMethod failed:" << plugin->name() << pluginPath;
+        qWarning() << "Creation of InputMethod failed:" << plugin->name() << desc.loader->fileName();
         delete host;
-        delete loader;
-        return 0;
+        return false;
     }
 
-    PluginDescription desc = { im, host, PluginState(),
-                               Maliit::SwitchUndefined, fileName, loader, windowGroup };
-
     // Connect surface group signals
     QObject::connect(windowGroup.data(), SIGNAL(inputMethodAreaChanged(QRegion)),
                      mICConnection.data(), SLOT(updateInputMethodArea(QRegion)));
+    if (applicationWindow) {
+        windowGroup->setApplicationWindow(applicationWindow);
+    }
 
-    plugins.insert(plugin, desc);
+    desc.inputMethod = im;
+    desc.imHost = host;
+    profiler.addInputMethod(im, desc.pluginId);
+    desc.windowGroup = windowGroup;
     host->setInputMethod(im);
 
-    webOSLogInfo("VKB_VERSION", "PLUGIN", plugin->name() + pluginVersion);
+    // Stays connected while the plugin is inactive, so that its cached
+    // subviews are dropped whenever it changes them
+    QObject::connect(im, &MAbstractInputMethod::subViewsChanged, q, [this, plugin]() {
+        subViewsChanged(plugin);
+    });
 
-    Q_EMIT q->pluginLoaded();
+    // The input method now answers instead of the declared subviews
+    desc.subViewsCache.clear();
+    desc.subViewsSignalled = false;
+    desc.prewarmed = false;
+    availableSubViewsCache.clear();
 
-    qWarning() << pluginPath << "is loaded successfully in" << plugin;
+    return true;
+}
 
-    return plugin;
+QSet<QString> MIMPluginManagerPrivate::configuredPluginIds() const
+{
+    QSet<QString> pluginIds;
+
+    InputSourceToNameMap::const_iterator end = inputSourceToNameMap.constEnd();
+    for (InputSourceToNameMap::const_iterator i(inputSourceToNameMap.constBegin()); i != end; ++i) {
+        pluginIds.insert(configuredPluginId(i.key()));
+    }
+    pluginIds.insert(onScreenPlugins.activeSubView().plugin);
+
+    return pluginIds;
+}
+
+MIMPluginManagerPrivate::SubViews
+MIMPluginManagerPrivate::pluginSubViews(const PluginDescription &desc,
+                                        Maliit::HandlerState state) const
+{
+    if (desc.inputMethod) {
+        if (!desc.subViewsSignalled) {
+            return desc.inputMethod->subViews(state);
+        }
+        QHash<Maliit::HandlerState, SubViews>::const_iterator cached = desc.subViewsCache.constFind(state);
+        if (cached == desc.subViewsCache.constEnd()) {
+            cached = desc.subViewsCache.insert(state, desc.inputMethod->subViews(state));
+        }
+        return cached.value();
+    }
+    if (state == Maliit::OnScreen) {
+        return desc.declaredSubViews;
+    }
+    return SubViews();
 }
 
 bool MIMPluginManagerPrivate::unloadPlugin(Maliit::Plugins::InputMethodPlugin *plugin)
@@ -235,17 +770,25 @@ bool MIMPluginManagerPrivate::unloadPlugin(Maliit::Plugins::InputMethodPlugin *p
 
     PluginDescription desc = plugins.value(plugin);
 
-    if (!switchPlugin(Maliit::SwitchForward, desc.inputMethod)) {
+    // only an active plugin needs a replacement
+    if (desc.inputMethod && activePlugins.contains(plugin)
+        && !switchPlugin(Maliit::SwitchForward, desc.inputMethod)) {
         qWarning() << "There seems no other plugin to activate in replacement of" << desc.pluginId << ". Could not unload";
         return false;
     }
 
     plugins.remove(plugin);
+    if (pluginsById.value(desc.pluginId) == plugin) {
+        pluginsById.remove(desc.pluginId);
+    }
+    availableSubViewsCache.clear();
     desc.windowGroup.clear();
     if (desc.imHost)
         delete desc.imHost;
-    if (desc.inputMethod)
+    if (desc.inputMethod) {
+        profiler.removeInputMethod(desc.inputMethod);
         delete desc.inputMethod;
+    }
 
     if (desc.loader) {
         if (!desc.loader->isLoaded()) {
@@ -273,11 +816,18 @@ void MIMPluginManagerPrivate::activatePlugin(Maliit::Plugins::InputMethodPlugin
     if (!plugin || activePlugins.contains(plugin)) {
         return;
     }
+
+    const Plugins::iterator iterator = plugins.find(plugin);
+    if (iterator == plugins.end() || !createInputMethod(iterator)) {
+        qWarning() << "Cannot activate plugin" << plugin;
+        return;
+    }
     webOSLogInfo("SWITCHPLUGIN", "STATE_CHANGE", plugin->name());
 
     MAbstractInputMethod *inputMethod = 0;
 
     activePlugins.insert(plugin);
+    iterator->prewarmed = false;
     inputMethod = plugins.value(plugin).inputMethod;
     plugins.value(plugin).imHost->setEnabled(true);
 
@@ -288,20 +838,21 @@ void MIMPluginManagerPrivate::activatePlugin(Maliit::Plugins::InputMethodPlugin
                      q,
                      SLOT(_q_setActiveSubView(QString, Maliit::HandlerState)));
 
-
-    inputMethod->handleAppOrientationChanged(lastOrientation);
-    targets.insert(inputMethod);
+    {
+        MImPluginProfiler::Call call(profiler, inputMethod, MImPluginProfiler::HandleAppOrientationChange);
+        inputMethod->handleAppOrientationChanged(lastOrientation);
+    }
+    targets.append(inputMethod);
 }
 
 
 void MIMPluginManagerPrivate::addHandlerMap(Maliit::HandlerState state,
                                             const QString &pluginId)
 {
-    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
-        if (plugins.value(plugin).pluginId == pluginId) {
-            handlerToPlugin[state] = plugin;
-            return;
-        }
+    Maliit::Plugins::InputMethodPlugin *plugin = pluginById(pluginId);
+    if (plugin) {
+        handlerToPlugin[state] = plugin;
+        return;
     }
     qWarning() << "Could not find plugin:" << pluginId;
 }
@@ -313,7 +864,7 @@ MImPluginSettingsInfo MIMPluginManagerPrivate::globalSettings() const
 
     Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
         const MIMPluginManagerPrivate::PluginDescription &descr = plugins[plugin];
-        QList<MAbstractInputMethod::MInputMethodSubView> subviews = descr.inputMethod->subViews();
+        const SubViews subviews = pluginSubViews(descr, Maliit::OnScreen);
 
         Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subview, subviews) {
             domain.append(descr.pluginId + ":" + subview.subViewId);
@@ -418,6 +969,7 @@ void MIMPluginManagerPrivate::setActiveHandlers(const QSet<Maliit::HandlerState>
 
                 if (visible) {
                     ensureActivePluginsVisible(DontShowInputMethod);
+                    MImPluginProfiler::Call call(profiler, inputMethod, MImPluginProfiler::Show);
                     inputMethod->show();
                     inputMethod->showLanguageNotification();
                 }
@@ -427,7 +979,9 @@ void MIMPluginManagerPrivate::setActiveHandlers(const QSet<Maliit::HandlerState>
 
     // notify plugins about new states
     Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, activatedPlugins) {
-        plugins.value(plugin).inputMethod->setState(plugins.value(plugin).state);
+        const PluginDescription &desc = plugins[plugin];
+        MImPluginProfiler::Call call(profiler, desc.inputMethod, MImPluginProfiler::SetState);
+        desc.inputMethod->setState(desc.state);
     }
 
     // deactivate unnecessary plugins
@@ -437,14 +991,28 @@ void MIMPluginManagerPrivate::setActiveHandlers(const QSet<Maliit::HandlerState>
             deactivatePlugin(plugin);  //activePlugins is modified here
         }
     }
+
+    if (states.contains(Maliit::OnScreen)) {
+        prewarmTimer.start();
+    }
 }
 
 
 QSet<Maliit::HandlerState> MIMPluginManagerPrivate::activeHandlers() const
 {
     QSet<Maliit::HandlerState> handlers;
-    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, activePlugins) {
-        handlers << handlerToPlugin.key(plugin);
+    ActivePlugins unmapped(activePlugins);
+
+    // handlerToPlugin is ordered by state, so each active plugin gets its
+    // first state, as a reverse QMap::key() lookup would return
+    for (HandlerMap::const_iterator i = handlerToPlugin.constBegin();
+         i != handlerToPlugin.constEnd() && !unmapped.isEmpty(); ++i) {
+        if (unmapped.remove(i.value())) {
+            handlers << i.key();
+        }
+    }
+    if (!unmapped.isEmpty()) {
+        handlers << Maliit::HandlerState(); // QMap::key() default for unmapped plugins
     }
     return handlers;
 }
@@ -464,15 +1032,24 @@ void MIMPluginManagerPrivate::deactivatePlugin(Maliit::Plugins::InputMethodPlugi
 
     Q_ASSERT(inputMethod);
 
-    inputMethod->hide();
-    inputMethod->reset();
+    {
+        MImPluginProfiler::Call call(profiler, inputMethod, MImPluginProfiler::Hide);
+        inputMethod->hide();
+    }
+    {
+        MImPluginProfiler::Call call(profiler, inputMethod, MImPluginProfiler::Reset);
+        inputMethod->reset();
+    }
 
     // this call disables normal behaviour on inputMethod->hide
     plugins.value(plugin).imHost->setEnabled(false);
 
     plugins[plugin].state = PluginState();
-    QObject::disconnect(inputMethod, 0, q, 0);
-    targets.remove(inputMethod);
+    QObject::disconnect(inputMethod,
+                        SIGNAL(activeSubViewChanged(QString, Maliit::HandlerState)),
+                        q,
+                        SLOT(_q_setActiveSubView(QString, Maliit::HandlerState)));
+    targets.removeOne(inputMethod);
 }
 
 void MIMPluginManagerPrivate::replacePlugin(Maliit::SwitchDirection direction,
@@ -480,6 +1057,10 @@ void MIMPluginManagerPrivate::replacePlugin(Maliit::SwitchDirection direction,
                                             Plugins::iterator replacement,
                                             const QString &subViewId)
 {
+    QElapsedTimer switchTimer;
+    switchTimer.start();
+    const bool prewarmed = replacement->prewarmed;
+
     PluginState state;
     if (source)
         state = plugins.value(source).state;
@@ -527,6 +1108,94 @@ void MIMPluginManagerPrivate::replacePlugin(Maliit::SwitchDirection direction,
         }
         // Save the last active subview
         onScreenPlugins.setActiveSubView(MImOnScreenPlugins::SubView(replacement->pluginId, activeSubViewIdOnScreen));
+        prewarmTimer.start();
+    }
+
+    const qint64 elapsedUs = switchTimer.nsecsElapsed() / 1000;
+    SwitchStats &stats = switchStats[prewarmNeighboursEnabled() ? 1 : 0];
+    ++stats.count;
+    if (prewarmed) {
+        ++stats.prewarmed;
+    }
+    stats.totalUs += elapsedUs;
+    stats.maxUs = qMax(stats.maxUs, elapsedUs);
+
+    qDebug() << "Switched to" << replacement->pluginId << "in" << elapsedUs << "us"
+             << (prewarmed ? "(prewarmed)" : "(not prewarmed)");
+}
+
+bool MIMPluginManagerPrivate::prewarmNeighboursEnabled() const
+{
+    return prewarmNeighboursConf && prewarmNeighboursConf->value(QVariant(false)).toBool();
+}
+
+void MIMPluginManagerPrivate::dumpSwitchStats() const
+{
+    for (int enabled = 0; enabled < 2; ++enabled) {
+        const SwitchStats &stats = switchStats[enabled];
+        if (!stats.count) {
+            continue;
+        }
+        qWarning() << "Plugin switches with prewarm" << (enabled ? "on:" : "off:") << stats.count
+                   << "switches," << stats.prewarmed << "prewarmed, mean"
+                   << stats.totalUs / stats.count << "us, max" << stats.maxUs << "us";
+    }
+}
+
+void MIMPluginManagerPrivate::subViewsChanged(Maliit::Plugins::InputMethodPlugin *plugin)
+{
+    const Plugins::iterator iterator = plugins.find(plugin);
+    if (iterator == plugins.end()) {
+        return;
+    }
+
+    iterator->subViewsCache.clear();
+    iterator->subViewsSignalled = true;
+    availableSubViewsCache.clear();
+}
+
+void MIMPluginManagerPrivate::_q_stallThresholdChanged()
+{
+    bool converted = false;
+    const int threshold = stallThresholdConf->value(QVariant(DefaultStallThreshold)).toInt(&converted);
+    profiler.setStallThreshold(converted ? threshold : DefaultStallThreshold);
+}
+
+Maliit::Plugins::InputMethodPlugin *MIMPluginManagerPrivate::pluginById(const QString &pluginId) const
+{
+    return pluginsById.value(pluginId);
+}
+
+void MIMPluginManagerPrivate::_q_prewarmNeighbours()
+{
+    if (!prewarmNeighboursEnabled()) {
+        return;
+    }
+
+    Maliit::Plugins::InputMethodPlugin *plugin = activePlugin(Maliit::OnScreen);
+    if (!plugin || !activePlugins.contains(plugin)) {
+        return;
+    }
+
+    const Plugins::const_iterator current = plugins.constFind(plugin);
+    const Maliit::SwitchDirection directions[] = { Maliit::SwitchBackward, Maliit::SwitchForward };
+    for (int i = 0; i < 2; ++i) {
+        const Plugins::const_iterator neighbour = findEnabledPlugin(current, directions[i], Maliit::OnScreen);
+        if (neighbour == plugins.constEnd() || activePlugins.contains(neighbour.key())) {
+            continue;
+        }
+
+        // The window group stays inactive, so the windows are kept hidden
+        const Plugins::iterator iterator = plugins.find(neighbour.key());
+        if (iterator->prewarmed || !createInputMethod(iterator)) {
+            continue;
+        }
+
+        MImExtensionEvent event(MImExtensionEvent::Prewarm);
+        MImPluginProfiler::Call call(profiler, iterator->inputMethod, MImPluginProfiler::ImExtensionEvent);
+        (void) iterator->inputMethod->imExtensionEvent(&event);
+        iterator->prewarmed = true;
+        qDebug() << "Pre-warmed" << iterator->pluginId;
     }
 }
 
@@ -543,7 +1212,7 @@ bool MIMPluginManagerPrivate::switchPlugin(Maliit::SwitchDirection direction,
     Plugins::iterator iterator(plugins.begin());
 
     for (; iterator != plugins.end(); ++iterator) {
-        if (iterator->inputMethod == initiator) {
+        if (initiator && iterator->inputMethod == initiator) {
             break;
         }
     }
@@ -584,7 +1253,7 @@ bool MIMPluginManagerPrivate::switchPlugin(const QString &pluginId,
     Plugins::iterator iterator(plugins.begin());
 
     for (; iterator != plugins.end(); ++iterator) {
-        if (iterator->inputMethod == initiator) {
+        if (initiator && iterator->inputMethod == initiator) {
             break;
         }
     }
@@ -592,11 +1261,7 @@ bool MIMPluginManagerPrivate::switchPlugin(const QString &pluginId,
     Plugins::iterator source = iterator;
 
     // find plugin specified by name
-    for (iterator = plugins.begin(); iterator != plugins.end(); ++iterator) {
-        if (plugins.value(iterator.key()).pluginId == pluginId) {
-            break;
-        }
-    }
+    iterator = plugins.find(pluginById(pluginId));
 
     if (iterator == plugins.end()) {
         qWarning() << pluginId << "could not be found";
@@ -653,6 +1318,10 @@ bool MIMPluginManagerPrivate::trySwitchPlugin(Maliit::SwitchDirection direction,
         }
     }
 
+    if (!createInputMethod(replacement)) {
+        return false;
+    }
+
     changeHandlerMap(source, newPlugin, newPlugin->supportedStates());
     replacePlugin(direction, source, replacement, subViewId);
 
@@ -664,6 +1333,25 @@ QString MIMPluginManagerPrivate::inputSourceName(Maliit::HandlerState source) co
     return inputSourceToNameMap.value(source);
 }
 
+QString MIMPluginManagerPrivate::configuredPluginId(Maliit::HandlerState state) const
+{
+    const MImSettings *conf = handlerToPluginConfs.value(state);
+    if (conf) {
+        return conf->value().toString();
+    }
+    return MImSettings(PluginRoot + "/" + inputSourceName(state)).value().toString();
+}
+
+void MIMPluginManagerPrivate::setConfiguredPluginId(Maliit::HandlerState state, const QString &pluginId)
+{
+    MImSettings *conf = handlerToPluginConfs.value(state);
+    if (conf) {
+        conf->set(pluginId);
+    } else {
+        MImSettings(PluginRoot + "/" + inputSourceName(state)).set(pluginId);
+    }
+}
+
 void MIMPluginManagerPrivate::changeHandlerMap(Maliit::Plugins::InputMethodPlugin *origin,
                                                Maliit::Plugins::InputMethodPlugin *replacement,
                                                QSet<Maliit::HandlerState> states)
@@ -678,8 +1366,7 @@ void MIMPluginManagerPrivate::changeHandlerMap(Maliit::Plugins::InputMethodPlugi
             // Update settings entry to record new plugin for handler map.
             // This should be done after real changing the handler map,
             // to prevent _q_syncHandlerMap also being called to change handler map.
-            MImSettings setting(PluginRoot + "/" + inputSourceName(state));
-            setting.set(plugins.value(replacement).pluginId);
+            setConfiguredPluginId(state, plugins.value(replacement).pluginId);
         }
     }
 }
@@ -700,9 +1387,10 @@ QStringList MIMPluginManagerPrivate::loadedPluginsNames(Maliit::HandlerState sta
 {
     QStringList result;
 
-    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
-        if (plugin->supportedStates().contains(state))
-            result.append(plugins.value(plugin).pluginId);
+    const Plugins::const_iterator end = plugins.constEnd();
+    for (Plugins::const_iterator iterator(plugins.constBegin()); iterator != end; ++iterator) {
+        if (iterator->supportedStates.contains(state))
+            result.append(iterator->pluginId);
     }
 
     return result;
@@ -718,7 +1406,7 @@ QList<MImPluginDescription> MIMPluginManagerPrivate::pluginDescriptions(Maliit::
          iterator != end;
          ++iterator) {
         const Maliit::Plugins::InputMethodPlugin * const plugin = iterator.key();
-        if (plugin && plugin->supportedStates().contains(state)) {
+        if (plugin && iterator->supportedStates.contains(state)) {
             result.append(MImPluginDescription(*plugin));
 
             if (state == Maliit::OnScreen) {
@@ -751,10 +1439,8 @@ MIMPluginManagerPrivate::findEnabledPlugin(Plugins::const_iterator current,
             --iterator;
         }
 
-        Maliit::Plugins::InputMethodPlugin *otherPlugin = iterator.key();
-        Q_ASSERT(otherPlugin);
-        const MIMPluginManagerPrivate::PluginState &supportedStates = otherPlugin->supportedStates();
-        if (!supportedStates.contains(state)) {
+        Q_ASSERT(iterator.key());
+        if (!iterator->supportedStates.contains(state)) {
             continue;
         }
 
@@ -811,6 +1497,10 @@ MIMPluginManagerPrivate::surroundingSubViewDescriptions(Maliit::HandlerState sta
     Plugins::const_iterator iterator = plugins.find(plugin);
     Q_ASSERT(iterator != plugins.constEnd());
 
+    if (!iterator->inputMethod) {
+        return result;
+    }
+
     QString pluginId = iterator->pluginId;
     QString subViewId = iterator->inputMethod->activeSubView(state);
     QMap<QString, QString> subViews = availableSubViews(pluginId, state);
@@ -895,16 +1585,14 @@ void MIMPluginManagerPrivate::loadHandlerMap()
 {
     Q_Q(MIMPluginManager);
 
-    static QSignalMapper *signalMapper = 0;
-
     // These variables should be reset whenever this method is called
-    if (signalMapper) {
+    if (handlerConfMapper) {
         qDeleteAll(handlerToPluginConfs);
         handlerToPluginConfs.clear();
         handlerToPlugin.clear();
-        delete signalMapper;
+        delete handlerConfMapper;
     }
-    signalMapper = new QSignalMapper(q);
+    handlerConfMapper = new QSignalMapper(q);
 
     // Queries all children under PluginRoot, each is a setting entry that maps an
     // input source to a plugin that handles it
@@ -918,13 +1606,13 @@ void MIMPluginManagerPrivate::loadHandlerMap()
             continue;
 
         MImSettings *handlerItem = new MImSettings(settingsKey);
-        handlerToPluginConfs.append(handlerItem);
+        handlerToPluginConfs.insert(i.key(), handlerItem);
         const QString &pluginName = handlerItem->value().toString();
         addHandlerMap(i.key(), pluginName);
-        QObject::connect(handlerItem, SIGNAL(valueChanged()), signalMapper, SLOT(map()));
-        signalMapper->setMapping(handlerItem, i.key());
+        QObject::connect(handlerItem, SIGNAL(valueChanged()), handlerConfMapper, SLOT(map()));
+        handlerConfMapper->setMapping(handlerItem, i.key());
     }
-    QObject::connect(signalMapper, SIGNAL(mapped(int)), q, SLOT(_q_syncHandlerMap(int)));
+    QObject::connect(handlerConfMapper, SIGNAL(mapped(int)), q, SLOT(_q_syncHandlerMap(int)));
 }
 
 
@@ -933,21 +1621,14 @@ void MIMPluginManagerPrivate::_q_syncHandlerMap(int state)
     const Maliit::HandlerState source = static_cast<Maliit::HandlerState>(state);
 
     Maliit::Plugins::InputMethodPlugin *currentPlugin = activePlugin(source);
-    MImSettings setting(PluginRoot + "/" + inputSourceName(source));
-    const QString pluginId = setting.value().toString();
+    const QString pluginId = configuredPluginId(source);
 
     // already synchronized.
     if (currentPlugin && pluginId == plugins.value(currentPlugin).pluginId) {
        return;
     }
 
-    Maliit::Plugins::InputMethodPlugin *replacement = 0;
-    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
-        if (plugins.value(plugin).pluginId == pluginId) {
-            replacement = plugin;
-            break;
-        }
-    }
+    Maliit::Plugins::InputMethodPlugin *replacement = pluginById(pluginId);
     if (replacement) {
         // switch plugin if handler is changed.
         MAbstractInputMethod *inputMethod = plugins.value(currentPlugin).inputMethod;
@@ -970,14 +1651,7 @@ void MIMPluginManagerPrivate::_q_onScreenSubViewChanged()
         return;
     }
 
-    Maliit::Plugins::InputMethodPlugin *replacement = 0;
-    Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
-        if (plugins.value(plugin).pluginId == subView.plugin) {
-            replacement = plugin;
-            break;
-        }
-    }
-
+    Maliit::Plugins::InputMethodPlugin *replacement = pluginById(subView.plugin);
     if (replacement) {
         // switch plugin if handler is changed.
         MAbstractInputMethod *inputMethod = 0;
@@ -1068,7 +1742,11 @@ void MIMPluginManagerPrivate::hideActivePlugins()
 {
     visible = false;
     Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, activePlugins) {
-        plugins.value(plugin).inputMethod->hide();
+        {
+            MAbstractInputMethod *inputMethod = plugins.value(plugin).inputMethod;
+            MImPluginProfiler::Call call(profiler, inputMethod, MImPluginProfiler::Hide);
+            inputMethod->hide();
+        }
         plugins.value(plugin).windowGroup->deactivate(Maliit::WindowGroup::HideDelayed);
     }
 
@@ -1085,9 +1763,10 @@ void MIMPluginManagerPrivate::ensureActivePluginsVisible(ShowInputMethodRequest
         if (activePlugins.contains(iterator.key())) {
             iterator.value().windowGroup->activate();
             if (request == ShowInputMethod) {
+                MImPluginProfiler::Call call(profiler, iterator.value().inputMethod, MImPluginProfiler::Show);
                 iterator.value().inputMethod->show();
             }
-        } else {
+        } else if (iterator.value().windowGroup) {
             iterator.value().windowGroup->deactivate(Maliit::WindowGroup::HideImmediate);
         }
     }
@@ -1098,17 +1777,12 @@ MIMPluginManagerPrivate::availableSubViews(const QString &plugin,
                                            Maliit::HandlerState state) const
 {
     QMap<QString, QString> subViews;
-    Plugins::const_iterator iterator(plugins.constBegin());
+    const Plugins::const_iterator iterator = plugins.constFind(pluginById(plugin));
 
-    for (; iterator != plugins.constEnd(); ++iterator) {
-        if (plugins.value(iterator.key()).pluginId == plugin) {
-            if (iterator->inputMethod) {
-                Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subView,
-                         iterator->inputMethod->subViews(state)) {
-                    subViews.insert(subView.subViewId, subView.subViewTitle);
-                }
-            }
-            break;
+    if (iterator != plugins.constEnd()) {
+        Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subView,
+                 pluginSubViews(iterator.value(), state)) {
+            subViews.insert(subView.subViewId, subView.subViewTitle);
         }
     }
     return subViews;
@@ -1117,27 +1791,73 @@ MIMPluginManagerPrivate::availableSubViews(const QString &plugin,
 QList<MImOnScreenPlugins::SubView>
 MIMPluginManagerPrivate::availablePluginsAndSubViews(Maliit::HandlerState state) const
 {
+    const QHash<Maliit::HandlerState, QList<MImOnScreenPlugins::SubView> >::const_iterator cached
+        = availableSubViewsCache.constFind(state);
+    if (cached != availableSubViewsCache.constEnd()) {
+        return cached.value();
+    }
+
     QList<MImOnScreenPlugins::SubView> pluginsAndSubViews;
     Plugins::const_iterator iterator(plugins.constBegin());
+    // Only cached when no input method can change its subviews silently
+    bool cacheable = true;
 
     for (; iterator != plugins.constEnd(); ++iterator) {
-        if (iterator->inputMethod) {
-            const QString plugin = plugins.value(iterator.key()).pluginId;
-            Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subView,
-                     iterator->inputMethod->subViews(state)) {
-                pluginsAndSubViews.append(MImOnScreenPlugins::SubView(plugin, subView.subViewId));
-            }
+        const QString &plugin = iterator->pluginId;
+        if (iterator->inputMethod && !iterator->subViewsSignalled) {
+            cacheable = false;
+        }
+        Q_FOREACH (const MAbstractInputMethod::MInputMethodSubView &subView,
+                 pluginSubViews(iterator.value(), state)) {
+            pluginsAndSubViews.append(MImOnScreenPlugins::SubView(plugin, subView.subViewId));
         }
     }
 
+    if (cacheable) {
+        availableSubViewsCache.insert(state, pluginsAndSubViews);
+    }
     return pluginsAndSubViews;
 }
 
+bool MIMPluginManagerPrivate::isInterestedIn(const MAbstractInputMethod *target,
+                                             const MImUpdateEvent &event) const
+{
+    const QStringList properties(target->interestingProperties());
+
+    if (properties.isEmpty()) {
+        return true;
+    }
+
+    Q_FOREACH (const QString &property, properties) {
+        if (event.isChanged(property)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+MAbstractInputMethod *MIMPluginManagerPrivate::hardwareKeyTarget() const
+{
+    const HandlerMap::const_iterator handler = handlerToPlugin.constFind(Maliit::Hardware);
+    if (handler == handlerToPlugin.constEnd()) {
+        return 0;
+    }
+
+    const Plugins::const_iterator plugin = plugins.constFind(handler.value());
+    if (plugin == plugins.constEnd() || !plugin->state.contains(Maliit::Hardware)) {
+        return 0;
+    }
+    if (targets.size() != 1 || targets.first() != plugin->inputMethod) {
+        return 0;
+    }
+    return plugin->inputMethod;
+}
+
 QString MIMPluginManagerPrivate::activeSubView(Maliit::HandlerState state) const
 {
     QString subView;
     Maliit::Plugins::InputMethodPlugin *currentPlugin = activePlugin(state);
-    if (currentPlugin) {
+    if (currentPlugin && plugins.value(currentPlugin).inputMethod) {
         subView = plugins.value(currentPlugin).inputMethod->activeSubView(state);
     }
     return subView;
@@ -1163,20 +1883,16 @@ void MIMPluginManagerPrivate::setActivePlugin(const QString &pluginId,
 
         return;
     }
-    MImSettings currentPluginConf(PluginRoot + "/" + inputSourceName(state));
-    if (!pluginId.isEmpty() && currentPluginConf.value().toString() != pluginId) {
+    if (!pluginId.isEmpty() && configuredPluginId(state) != pluginId) {
         // check whether the pluginName is valid
-        Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, plugins.keys()) {
-            if (plugins.value(plugin).pluginId == pluginId) {
-                currentPluginConf.set(pluginId);
-                // Force call _q_syncHandlerMap() even though we already connect
-                // _q_syncHandlerMap() with MImSettings valueChanged(). Because if the
-                // request comes from different threads, the _q_syncHandlerMap()
-                // won't be called at once. This means the synchronization of
-                // handler map could be delayed if we don't force call it.
-                _q_syncHandlerMap(state);
-                break;
-            }
+        if (pluginById(pluginId)) {
+            setConfiguredPluginId(state, pluginId);
+            // Force call _q_syncHandlerMap() even though we already connect
+            // _q_syncHandlerMap() with MImSettings valueChanged(). Because if the
+            // request comes from different threads, the _q_syncHandlerMap()
+            // won't be called at once. This means the synchronization of
+            // handler map could be delayed if we don't force call it.
+            _q_syncHandlerMap(state);
         }
     }
 }
@@ -1200,6 +1916,7 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
     qRegisterMetaType<Qt::Key>("Qt::Key");
     qRegisterMetaType<Qt::KeyboardModifiers>("Qt::KeyboardModifiers");
     qRegisterMetaType<WId>("WId");
+    qRegisterMetaType<MImKeyEvent>("MImKeyEvent");
 
     // Connect connection to our handlers
     connect(d->mICConnection.data(), SIGNAL(showInputMethodRequest()),
@@ -1229,8 +1946,8 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
     connect(d->mICConnection.data(), SIGNAL(mouseClickedOnPreedit(QPoint,QRect)),
             this, SLOT(handleMouseClickOnPreedit(QPoint,QRect)));
 
-    connect(d->mICConnection.data(), SIGNAL(receivedKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)),
-            this, SLOT(processKeyEvent(QEvent::Type,Qt::Key,Qt::KeyboardModifiers,QString,bool,int,quint32,quint32,ulong)));
+    connect(d->mICConnection.data(), SIGNAL(receivedKeyEvent(MImKeyEvent)),
+            this, SLOT(processKeyEvent(MImKeyEvent)));
 
     connect(d->mICConnection.data(), SIGNAL(widgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)),
             this, SLOT(handleWidgetStateChanged(uint,QMap<QString,QVariant>,QMap<QString,QVariant>,bool)));
@@ -1288,7 +2005,9 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
     connect(d->attributeExtensionManager.data(), SIGNAL(globalAttributeChanged(MAttributeExtensionId,QString,QString,QVariant)),
             this, SLOT(onGlobalAttributeChanged(MAttributeExtensionId,QString,QString,QVariant)));
 
-    d->blacklist = MImSettings(MImPluginDisabled).value().toStringList();
+    d->pluginPathsConf = new MImSettings(MImPluginPaths);
+    d->pluginDisabledConf = new MImSettings(MImPluginDisabled);
+    d->blacklist = d->pluginDisabledConf->value().toStringList();
 
     connect(&d->onScreenPlugins, SIGNAL(activeSubViewChanged()), this, SLOT(_q_onScreenSubViewChanged()));
     connect(&d->onScreenPlugins, SIGNAL(enabledPluginsChanged()), this, SIGNAL(pluginsChanged()));
@@ -1297,20 +2016,41 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
 
     d->imAccessoryEnabledConf = new MImSettings(MImAccesoryEnabled);
     d->imAccessoryEnabledConf->set(false); // start Maliit with accessory disabled
+    d->prewarmNeighboursConf = new MImSettings(MImPrewarmNeighbours);
+
+    // Plugin calls slower than this many milliseconds are logged
+    d->stallThresholdConf = new MImSettings(MImStallThreshold);
+    connect(d->stallThresholdConf, SIGNAL(valueChanged()), this, SLOT(_q_stallThresholdChanged()));
+    d->_q_stallThresholdChanged();
+    d->profiler.setWidgetState(&d->mICConnection->widgetState());
+
+    // Neighbours are pre-warmed once the event loop is idle again
+    d->prewarmTimer.setSingleShot(true);
+    d->prewarmTimer.setInterval(0);
+    connect(&d->prewarmTimer, SIGNAL(timeout()), this, SLOT(_q_prewarmNeighbours()));
+
+    // One deferred plugin file per event loop iteration, so that clients
+    // are served in between
+    d->deferredPluginTimer.setSingleShot(true);
+    d->deferredPluginTimer.setInterval(0);
+    connect(&d->deferredPluginTimer, SIGNAL(timeout()), this, SLOT(_q_loadDeferredPlugin()));
     d->shutDownInterval = new MImSettings("timeout");
     d->isStaticService = new MImSettings("static");
+    d->hibernateEnabled = new MImSettings("hibernate");
     d->localeInfo = new MImSettings("localeInfo");
 
-    connect(&(d->shutDownTimer), &QTimer::timeout, this, &MIMPluginManager::quitByShutdownTimer);
+    connect(&(d->shutDownTimer), &QTimer::timeout, this, &MIMPluginManager::handleShutdownTimer);
 
     // Set initial timer if it is respawned in dynamic mode
     if (QString::fromLocal8Bit(qgetenv("STATIC")) == "false" && QString::fromLocal8Bit(qgetenv("RESPAWN")) == "true") {
         qWarning() << "Initial shutdown timer started and will expire in 5 seconds";
         d->shutDownTimer.start(5000);
+        d->snapshot.load();
     }
 
     connect(d->imAccessoryEnabledConf, SIGNAL(valueChanged()), this, SLOT(updateInputSource()));
     connect(d->localeInfo, SIGNAL(valueChanged()), this, SLOT(updatePlugins()));
+    connect(&d->pluginScan, SIGNAL(finished()), this, SLOT(_q_pluginFilesScanned()));
 
     updatePlugins();
 }
@@ -1319,6 +2059,7 @@ MIMPluginManager::MIMPluginManager(const QSharedPointer<MInputContextConnection>
 MIMPluginManager::~MIMPluginManager()
 {
     Q_D(MIMPluginManager);
+    d->profiler.dump();
     delete d;
 }
 
@@ -1370,70 +2111,53 @@ void MIMPluginManager::updatePlugins()
     // Check plugin dirs as per the current localeInfo
     // and update plugins only if there is any change
 
-    // Sorted list of the latest plugin dirs
-    static QStringList currentPluginDirs;
-
-    QStringList pluginDirs = MImSettings(MImPluginPaths).value(QStringList(DefaultPluginLocation)).toStringList();
-    QJsonObject localeJson;
+    QStringList pluginDirs;
 
-    if (d->localeInfo && !d->localeInfo->value().isNull()) {
-        localeJson = QJsonObject::fromVariantMap(d->localeInfo->value().toMap());
-        qInfo() << "Read localeInfo from SettingsService";
+    if (d->pluginDirs.isEmpty() && d->snapshot.isValid()) {
+        // Respawned: start with the plugin dirs of the previous instance,
+        // localeInfo from SettingsService reconciles through valueChanged()
+        pluginDirs = d->snapshot.pluginDirs();
+        qInfo() << "Read plugin dirs from snapshot" << pluginDirs
+                << "for keyboards" << d->snapshot.keyboards();
     } else {
-        // Try the file cache
-        QFile file(FileLocaleInfo);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            localeJson = QJsonDocument::fromJson(file.readAll()).object()["localeInfo"].toObject();
-            qInfo() << "Read localeInfo from file" << FileLocaleInfo;
-            file.close();
-        }
+        pluginDirs = d->localePluginDirs();
     }
 
-    if (!localeJson.isEmpty()) {
-        QString keyboardsLang = 0;
-        QJsonArray keyboardsArray = localeJson["keyboards"].toArray();
-
-        qDebug() << "keyboards in localeInfo:" << keyboardsArray;
-
-        if (!keyboardsArray.isEmpty()) {
-            for (ssize_t index = 0; index < keyboardsArray.size() ; ++index) {
-                if (!keyboardsArray[index].isNull()) {
-                    keyboardsLang = keyboardsArray[index].toString();
-                    webOSLogInfo("VKB_LANGUAGE", "keyboardLang", keyboardsLang);
-                    if (keyboardsLang == "ja") {
-                        webOSLogInfo("VKB_JP_PLUGIN", "plugin", "Japan Plugin Loading");
-                        pluginDirs.push_back(JapanesePluginLocation);
-                    } else if (keyboardsLang == "zh" || keyboardsLang == "zh-Hans"
-                        || keyboardsLang == "zh-Hant") {
-                        webOSLogInfo("VKB_ZH_PLUGIN", "plugin", "China Plugin Loading");
-                        pluginDirs.push_back(ChinesePluginLocation);
-                    }
-                }
-            }
-        }
-    } else {
-        qWarning() << "localeInfo is unavailable, try to load all known plugins";
-        webOSLogInfo("VKB_JP_PLUGIN", "plugin", "Japan Plugin Loading");
-        pluginDirs.push_back(JapanesePluginLocation);
-        webOSLogInfo("VKB_ZH_PLUGIN", "plugin", "China Plugin Loading");
-        pluginDirs.push_back(ChinesePluginLocation);
-    }
-
-    pluginDirs.sort();
-
-    if (pluginDirs == currentPluginDirs) {
+    if (pluginDirs == d->pluginDirs) {
         qInfo() << "No plugin dirs change. No plugins updated";
-    } else {
-        currentPluginDirs = pluginDirs;
+    } else if (d->pluginDirs.isEmpty()) {
+        d->pluginDirs = pluginDirs;
 
         qInfo() << "Update plugins!!";
 
         d->hideActivePlugins();
-        d->loadPlugins(currentPluginDirs);
+        d->loadPlugins(d->pluginDirs);
         d->loadHandlerMap();
         d->registerSettings();
         d->_q_onScreenSubViewChanged();
         updateInputSource();
+    } else {
+        // Only plugins of added and removed dirs are touched
+        QStringList addedDirs;
+        QStringList removedDirs;
+        Q_FOREACH (const QString &dir, pluginDirs) {
+            if (!d->pluginDirs.contains(dir))
+                addedDirs.append(dir);
+        }
+        Q_FOREACH (const QString &dir, d->pluginDirs) {
+            if (!pluginDirs.contains(dir))
+                removedDirs.append(dir);
+        }
+        d->pluginDirs = pluginDirs;
+
+        qInfo() << "Update plugins, added dirs:" << addedDirs << "removed dirs:" << removedDirs;
+
+        // Plugins of removed dirs are unloaded after the added ones are
+        // loaded, so that an active plugin can be replaced from those
+        if (!addedDirs.isEmpty())
+            d->addPluginDirs(addedDirs, removedDirs);
+        else if (!removedDirs.isEmpty())
+            d->removePluginDirs(removedDirs);
     }
 }
 
@@ -1472,6 +2196,8 @@ void MIMPluginManager::switchPlugin(Maliit::SwitchDirection direction,
     Q_D(MIMPluginManager);
 
     if (initiator) {
+        // Switching walks all plugins
+        d->finishDeferredPlugins();
         if (!d->switchPlugin(direction, initiator)) {
             // no next plugin, just switch context
             initiator->switchContext(direction, true);
@@ -1485,6 +2211,7 @@ void MIMPluginManager::switchPlugin(const QString &name,
     Q_D(MIMPluginManager);
 
     if (initiator) {
+        d->finishDeferredPlugins();
         if (!d->switchPlugin(name, initiator)) {
             qInfo() << "switching to plugin:" << name << " failed";
         }
@@ -1527,7 +2254,9 @@ void MIMPluginManager::setToolbar(const MAttributeExtensionId &id)
     Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, d->activePlugins) {
         if (callKeyOverrides)
         {
-            d->plugins.value(plugin).inputMethod->setKeyOverrides(keyOverrides);
+            MAbstractInputMethod *inputMethod = d->plugins.value(plugin).inputMethod;
+            MImPluginProfiler::Call call(d->profiler, inputMethod, MImPluginProfiler::SetKeyOverrides);
+            inputMethod->setKeyOverrides(keyOverrides);
         }
     }
 }
@@ -1562,12 +2291,14 @@ QString MIMPluginManager::activeSubView(Maliit::HandlerState state) const
 void MIMPluginManager::setActivePlugin(const QString &pluginName, Maliit::HandlerState state)
 {
     Q_D(MIMPluginManager);
+    d->finishDeferredPlugins();
     d->setActivePlugin(pluginName, state);
 }
 
 void MIMPluginManager::setActiveSubView(const QString &subViewId, Maliit::HandlerState state)
 {
     Q_D(MIMPluginManager);
+    d->finishDeferredPlugins();
     d->_q_setActiveSubView(subViewId, state);
 }
 
@@ -1578,13 +2309,18 @@ void MIMPluginManager::updateKeyOverrides()
         d->attributeExtensionManager->keyOverrides(d->toolbarId);
 
     Q_FOREACH (Maliit::Plugins::InputMethodPlugin *plugin, d->activePlugins) {
-        d->plugins.value(plugin).inputMethod->setKeyOverrides(keyOverrides);
+        MAbstractInputMethod *inputMethod = d->plugins.value(plugin).inputMethod;
+        MImPluginProfiler::Call call(d->profiler, inputMethod, MImPluginProfiler::SetKeyOverrides);
+        inputMethod->setKeyOverrides(keyOverrides);
     }
 }
 
 void MIMPluginManager::handleAppOrientationAboutToChange(int angle)
 {
+    Q_D(MIMPluginManager);
+
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleAppOrientationChange);
         target->handleAppOrientationAboutToChange(angle);
     }
 }
@@ -1596,6 +2332,7 @@ void MIMPluginManager::handleAppOrientationChanged(int angle)
     d->lastOrientation = angle;
 
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleAppOrientationChange);
         target->handleAppOrientationChanged(angle);
     }
 }
@@ -1604,9 +2341,13 @@ void MIMPluginManager::handleAppFocusChanged(WId id)
 {
     Q_D(MIMPluginManager);
 
+    d->applicationWindow = id;
+
     MIMPluginManagerPrivate::Plugins::iterator i = d->plugins.begin();
     while (i != d->plugins.end()) {
-        i.value().windowGroup.data()->setApplicationWindow(id);
+        if (i.value().windowGroup) {
+            i.value().windowGroup.data()->setApplicationWindow(id);
+        }
         ++i;
     }
 }
@@ -1616,7 +2357,7 @@ void MIMPluginManager::startShutdownTimer()
     Q_D(MIMPluginManager);
 
     d->shutDownTimer.stop();
-    if (d->isClientConnected) {
+    if (d->isClientConnected || d->hibernating) {
         return;
     }
 
@@ -1642,6 +2383,19 @@ void MIMPluginManager::quitByShutdownTimer() const
     QCoreApplication::quit();
 }
 
+void MIMPluginManager::handleShutdownTimer()
+{
+    Q_D(MIMPluginManager);
+
+    d->shutDownTimer.stop();
+    if (d->hibernateEnabled->value(QVariant(false)).toBool()) {
+        qWarning() << "Shutdown timer expired. Hibernate";
+        d->hibernate();
+    } else {
+        quitByShutdownTimer();
+    }
+}
+
 void MIMPluginManager::handleClientDisconnection()
 {
     Q_D(MIMPluginManager);
@@ -1659,6 +2413,7 @@ void MIMPluginManager::handleClientConnection()
 
     d->isClientConnected = true;
     d->shutDownTimer.stop();
+    d->wakeUp();
 
     handleClientChange();
 
@@ -1667,13 +2422,16 @@ void MIMPluginManager::handleClientConnection()
     connect(d->shutDownInterval, &MImSettings::valueChanged,
             this, &MIMPluginManager::startShutdownTimer, Qt::UniqueConnection);
     connect(&(d->shutDownTimer), &QTimer::timeout,
-            this, &MIMPluginManager::quitByShutdownTimer, Qt::UniqueConnection);
+            this, &MIMPluginManager::handleShutdownTimer, Qt::UniqueConnection);
 }
 
 void MIMPluginManager::handleClientChange()
 {
+    Q_D(MIMPluginManager);
+
     // notify plugins
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleClientChange);
         target->handleClientChange();
     }
 }
@@ -1683,6 +2441,7 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
                                                 const QMap<QString, QVariant> &oldState,
                                                 bool focusChanged)
 {
+    Q_D(MIMPluginManager);
     Q_UNUSED(clientId);
 
     // check visualization change
@@ -1700,23 +2459,15 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
         newVisualization = variant.toBool();
     }
 
-    // update state
-    QStringList changedProperties;
-    for (QMap<QString, QVariant>::const_iterator iter = newState.constBegin();
-         iter != newState.constEnd();
-         ++iter)
-    {
-        if (oldState.value(iter.key()) != iter.value()) {
-            changedProperties.append(iter.key());
-        }
-
-    }
+    // the connection has already diffed the typed state
+    const MImWidgetState &widgetState(d->mICConnection->widgetState());
+    const MImWidgetState::Fields changedFields(d->mICConnection->changedWidgetFields());
 
-    variant = newState[FocusStateAttribute];
-    const bool widgetFocusState = variant.toBool();
+    const bool widgetFocusState = widgetState.focusState();
 
     if (focusChanged) {
         Q_FOREACH (MAbstractInputMethod *target, targets()) {
+            MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleFocusChange);
             target->handleFocusChange(widgetFocusState);
         }
     }
@@ -1724,6 +2475,7 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
     // call notification methods if needed
     if (oldVisualization != newVisualization) {
         Q_FOREACH (MAbstractInputMethod *target, targets()) {
+            MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleVisualizationPriorityChange);
             target->handleVisualizationPriorityChange(newVisualization);
         }
     }
@@ -1734,13 +2486,18 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
         return;
     }
     const Qt::InputMethodHints lastHints(static_cast<int>(inputMethodHint));
-    MImUpdateEvent ev(newState, changedProperties, lastHints);
+    MImUpdateEvent ev(widgetState, changedFields, oldState, lastHints);
 
     // general notification last
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
-        if (not changedProperties.isEmpty()) {
+        if (not focusChanged && not d->isInterestedIn(target, ev)) {
+            continue;
+        }
+        if (changedFields != 0) {
+            MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::ImExtensionEvent);
             (void) target->imExtensionEvent(&ev);
         }
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::Update);
         target->update();
     }
 
@@ -1752,39 +2509,58 @@ void MIMPluginManager::handleWidgetStateChanged(unsigned int clientId,
 
 void MIMPluginManager::handleMouseClickOnPreedit(const QPoint &pos, const QRect &preeditRect)
 {
+    Q_D(MIMPluginManager);
+
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::HandleMouseClickOnPreedit);
         target->handleMouseClickOnPreedit(pos, preeditRect);
     }
 }
 
 void MIMPluginManager::handlePreeditChanged(const QString &text, int cursorPos)
 {
+    Q_D(MIMPluginManager);
+
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::SetPreedit);
         target->setPreedit(text, cursorPos);
     }
 }
 
 void MIMPluginManager::resetInputMethods()
 {
+    Q_D(MIMPluginManager);
+
     Q_FOREACH (MAbstractInputMethod *target, targets()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::Reset);
         target->reset();
     }
 }
 
-void MIMPluginManager::processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
-                     Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat, int count,
-                     quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time)
-
+void MIMPluginManager::processKeyEvent(const MImKeyEvent &event)
 {
-    Q_FOREACH (MAbstractInputMethod *target, targets()) {
-        target->processKeyEvent(keyType, keyCode, modifiers, text, autoRepeat, count,
-                nativeScanCode, nativeModifiers, time);
+    Q_D(MIMPluginManager);
+
+    // Keys go straight to the hardware handler while it is the only target
+    if (MAbstractInputMethod *target = d->hardwareKeyTarget()) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::ProcessKeyEvent);
+        target->processKeyEvent(event.type, event.key, event.modifiers, event.text,
+                                event.autoRepeat, event.count, event.nativeScanCode,
+                                event.nativeModifiers, event.time);
+        return;
+    }
+
+    Q_FOREACH (MAbstractInputMethod *target, d->targets) {
+        MImPluginProfiler::Call call(d->profiler, target, MImPluginProfiler::ProcessKeyEvent);
+        target->processKeyEvent(event.type, event.key, event.modifiers, event.text,
+                                event.autoRepeat, event.count, event.nativeScanCode,
+                                event.nativeModifiers, event.time);
     }
 }
 
-QSet<MAbstractInputMethod *> MIMPluginManager::targets()
+const QVector<MAbstractInputMethod *> &MIMPluginManager::targets() const
 {
-    Q_D(MIMPluginManager);
+    Q_D(const MIMPluginManager);
     return d->targets;
 }
 
@@ -1817,6 +2593,8 @@ void MIMPluginManager::pluginSettingsRequested(int clientId, const QString &desc
 {
     Q_D(MIMPluginManager);
 
+    // Settings of all plugins are described
+    d->finishDeferredPlugins();
     QList<MImPluginSettingsInfo> settings = d->settings;
 
     for (int i = 0; i < settings.count(); ++i) {
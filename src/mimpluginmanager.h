@@ -152,14 +152,13 @@ private Q_SLOTS:
     void handleClientChange();
     void startShutdownTimer();
     void quitByShutdownTimer() const;
+    void handleShutdownTimer();
     void handleWidgetStateChanged(unsigned int clientId, const QMap<QString, QVariant> &newState,
                                   const QMap<QString, QVariant> &oldState, bool focusChanged);
     void handleMouseClickOnPreedit(const QPoint &pos, const QRect &preeditRect);
     void handlePreeditChanged(const QString &text, int cursorPos);
 
-    void processKeyEvent(QEvent::Type keyType, Qt::Key keyCode,
-                         Qt::KeyboardModifiers modifiers, const QString &text, bool autoRepeat,
-                         int count, quint32 nativeScanCode, quint32 nativeModifiers, unsigned long time);
+    void processKeyEvent(const MImKeyEvent &event);
 
     void pluginSettingsRequested(int clientId, const QString &descriptionLanguage);
 
@@ -175,7 +174,7 @@ private Q_SLOTS:
                                   const QString &attribute,
                                   const QVariant &value);
 private:
-    QSet<MAbstractInputMethod *> targets();
+    const QVector<MAbstractInputMethod *> &targets() const;
 
 protected:
     MIMPluginManagerPrivate *const d_ptr;
@@ -187,6 +186,10 @@ private:
     Q_PRIVATE_SLOT(d_func(), void _q_syncHandlerMap(int))
     Q_PRIVATE_SLOT(d_func(), void _q_setActiveSubView(const QString &, Maliit::HandlerState))
     Q_PRIVATE_SLOT(d_func(), void _q_onScreenSubViewChanged())
+    Q_PRIVATE_SLOT(d_func(), void _q_pluginFilesScanned())
+    Q_PRIVATE_SLOT(d_func(), void _q_loadDeferredPlugin())
+    Q_PRIVATE_SLOT(d_func(), void _q_prewarmNeighbours())
+    Q_PRIVATE_SLOT(d_func(), void _q_stallThresholdChanged())
 
     friend class Ut_MIMPluginManager;
     friend class Ut_MIMPluginManagerConfig;
@@ -26,8 +26,12 @@
 #include "mimhwkeyboardtracker.h"
 #include <maliit/settingdata.h>
 #include <maliit/plugins/abstractpluginsetting.h>
+#include <maliit/plugins/abstractinputmethod.h>
 #include "windowgroup.h"
 #include "abstractplatform.h"
+#include "mimpluginindex.h"
+#include "mimserversnapshot.h"
+#include "mimpluginprofiler.h"
 
 #include <QtCore>
 #include <QTimer>
@@ -44,6 +48,7 @@ class MAttributeExtensionManager;
 class MSharedAttributeExtensionManager;
 class MImSettings;
 class MAbstractInputMethod;
+class MImUpdateEvent;
 class MIMPluginManagerAdaptor;
 
 /* Internal class only! Interfaces here change, internal developers only*/
@@ -78,7 +83,25 @@ public:
         ShowInputMethod
     };
 
+    typedef QList<MAbstractInputMethod::MInputMethodSubView> SubViews;
+
+    //! Result of the metadata scan of one file in a plugin directory
+    struct PluginFileInfo {
+        QString fileName;
+        QString path;
+        QString pluginDir;
+        bool isPlugin;
+        QString version;
+        bool hasSubViews; // OnScreen subviews are declared in the metadata
+        SubViews subViews;
+        bool stamped; // indexEntry holds the stamp of the file
+        bool indexed; // described by the plugin index, not scanned
+        MImPluginIndex::Entry indexEntry;
+    };
+
     struct PluginDescription {
+        // inputMethod, imHost and windowGroup are created on first use
+        // for plugins which declare their subviews in the metadata
         MAbstractInputMethod *inputMethod;
         MInputMethodHost *imHost;
         PluginState state;
@@ -86,6 +109,30 @@ public:
         QString pluginId; // the library filename is used as ID
         QPluginLoader *loader;
         QSharedPointer<Maliit::WindowGroup> windowGroup;
+        SubViews declaredSubViews;
+        QString pluginDir;
+        PluginState supportedStates;
+        // subViews() of inputMethod, by state. Only used once inputMethod
+        // emitted subViewsChanged(), since others may change them silently.
+        mutable QHash<Maliit::HandlerState, SubViews> subViewsCache;
+        bool subViewsSignalled;
+        // Prewarm was delivered to inputMethod since it was last active
+        bool prewarmed;
+    };
+
+    /*!
+     * Latency of the plugin switches, split by the prewarm neighbours
+     * setting at the time of the switch. Dumped on hibernate, so switching
+     * the same way with the setting on and off and letting the server go
+     * idle gives comparable figures in the log.
+     */
+    struct SwitchStats {
+        SwitchStats() : count(0), prewarmed(0), totalUs(0), maxUs(0) {}
+
+        int count;
+        int prewarmed; // switches to an input method which got Prewarm
+        qint64 totalUs;
+        qint64 maxUs;
     };
 
     typedef QMap<Maliit::Plugins::InputMethodPlugin *, PluginDescription> Plugins;
@@ -100,8 +147,35 @@ public:
     void autoDetectEnabledSubViews(const QString &plugin);
 
     void activatePlugin(Maliit::Plugins::InputMethodPlugin *plugin);
-    void loadPlugins(QStringList &pluginDirs);
-    Maliit::Plugins::InputMethodPlugin* loadPlugin(const QDir &dir, const QString &fileName);
+    void loadPlugins(const QStringList &pluginDirs);
+    QList<PluginFileInfo> collectPluginFiles(const QStringList &pluginDirs);
+    //! Loads \a files. With \a deferUnconfigured, files of plugins not configured
+    //! for a handler are left to _q_loadDeferredPlugin(), unless none is configured.
+    QList<Maliit::Plugins::InputMethodPlugin *> loadPluginFiles(const QList<PluginFileInfo> &files,
+                                                                bool deferUnconfigured = false);
+    //! Loads the deferred plugin files now
+    void finishDeferredPlugins();
+    //! Loads \a pluginDirs, then unloads \a replacedDirs so that their active plugins find a replacement
+    void addPluginDirs(const QStringList &pluginDirs, const QStringList &replacedDirs = QStringList());
+    void removePluginDirs(const QStringList &pluginDirs);
+    void finishPluginScan();
+    void updateLoadedPlugins();
+    //! Returns the sorted plugin dirs for the current localeInfo
+    QStringList localePluginDirs();
+
+    //! Releases windows, caches and subscriptions while the server is idle
+    void hibernate();
+    //! Undoes hibernate(), before the next client is served
+    void wakeUp();
+
+    bool prewarmNeighboursEnabled() const;
+    //! Logs switchStats
+    void dumpSwitchStats() const;
+    Maliit::Plugins::InputMethodPlugin* loadPlugin(const PluginFileInfo &info, bool createNow,
+                                                   MImPluginIndex::Rejection *rejection);
+    bool createInputMethod(Plugins::iterator plugin);
+    QSet<QString> configuredPluginIds() const;
+    SubViews pluginSubViews(const PluginDescription &desc, Maliit::HandlerState state) const;
     bool unloadPlugin(Maliit::Plugins::InputMethodPlugin *plugin);
     void addHandlerMap(Maliit::HandlerState state, const QString &pluginName);
     void registerSettings();
@@ -146,6 +220,15 @@ public:
     void showActivePlugins();
     void ensureActivePluginsVisible(ShowInputMethodRequest request);
 
+    //! Returns true if \a event changes a property \a target has declared
+    //! interest in, or if \a target has not declared any.
+    bool isInterestedIn(const MAbstractInputMethod *target, const MImUpdateEvent &event) const;
+
+    //! Returns the input method handling Maliit::Hardware, or 0 if that
+    //! handler is not active or other input methods are active too.
+    //! Hardware and Accessory can be active together, and both get keys.
+    MAbstractInputMethod *hardwareKeyTarget() const;
+
     /*!
      * This method is called when one of the handler map settings have changed
      * to synchronize the handlerToPluginConfs.
@@ -164,6 +247,30 @@ public:
      */
     void _q_onScreenSubViewChanged();
 
+    /*!
+     * \brief Loads the plugins of added plugin dirs once their files are scanned
+     */
+    void _q_pluginFilesScanned();
+    //! Loads the next deferred plugin file, one per event loop iteration
+    void _q_loadDeferredPlugin();
+
+    /*!
+     * \brief Creates the input methods of the OnScreen plugins next to the
+     * active one, so that switching to them only has to show them
+     */
+    void _q_prewarmNeighbours();
+
+    /*!
+     * \brief Drops cached subviews after the input method of \a plugin changed them
+     */
+    void subViewsChanged(Maliit::Plugins::InputMethodPlugin *plugin);
+
+    //! Applies the stall threshold setting to the profiler
+    void _q_stallThresholdChanged();
+
+    //! Returns the loaded plugin with \a pluginId, or 0
+    Maliit::Plugins::InputMethodPlugin *pluginById(const QString &pluginId) const;
+
     QMap<QString, QString> availableSubViews(const QString &plugin,
                                              Maliit::HandlerState state
                                               = Maliit::OnScreen) const;
@@ -174,24 +281,44 @@ public:
 
     QString inputSourceName(Maliit::HandlerState source) const;
 
+    //! Returns the plugin id configured for \a state
+    QString configuredPluginId(Maliit::HandlerState state) const;
+    void setConfiguredPluginId(Maliit::HandlerState state, const QString &pluginId);
+
     MIMPluginManager *parent;
     QSharedPointer<MInputContextConnection> mICConnection;
 
     Plugins plugins;
+    QHash<QString, Maliit::Plugins::InputMethodPlugin *> pluginsById;
+    // availablePluginsAndSubViews(), by state
+    mutable QHash<Maliit::HandlerState, QList<MImOnScreenPlugins::SubView> > availableSubViewsCache;
     ActivePlugins activePlugins;
-    QSet<MAbstractInputMethod *> targets;
+    // Input methods of active plugins, in activation order
+    QVector<MAbstractInputMethod *> targets;
     QList<MImPluginSettingsInfo> settings;
 
     QStringList blacklist;
     HandlerMap handlerToPlugin;
 
-    QList<MImSettings *> handlerToPluginConfs;
+    // Handler settings found by loadHandlerMap(), kept alive with their backends
+    QMap<Maliit::HandlerState, MImSettings *> handlerToPluginConfs;
+    // Maps valueChanged() of handlerToPluginConfs to _q_syncHandlerMap()
+    QSignalMapper *handlerConfMapper;
+    MImSettings *pluginPathsConf;
+    MImSettings *pluginDisabledConf;
     MImSettings *localeInfo;
     MImSettings *imAccessoryEnabledConf;
+    MImSettings *prewarmNeighboursConf;
+    MImSettings *stallThresholdConf;
     MImSettings *shutDownInterval;
     MImSettings *isStaticService;
+    MImSettings *hibernateEnabled;
 
     QTimer shutDownTimer;
+    QTimer prewarmTimer;
+    // Plugin files left by loadPlugins(), loaded by deferredPluginTimer
+    QList<PluginFileInfo> deferredPluginFiles;
+    QTimer deferredPluginTimer;
     QString activeSubViewIdOnScreen;
 
     MIMPluginManagerAdaptor *adaptor;
@@ -216,6 +343,31 @@ public:
     QSharedPointer<Maliit::AbstractPlatform> m_platform;
 
     bool isClientConnected;
+
+    // Last application window, for window groups created later
+    WId applicationWindow;
+
+    // Plugin files probed by earlier runs
+    MImPluginIndex pluginIndex;
+    // State derived by this or the previous server instance
+    MImServerSnapshot snapshot;
+
+    // Plugin dirs currently loaded, sorted
+    QStringList pluginDirs;
+    // Metadata scan of added plugin dirs
+    QFutureWatcher<PluginFileInfo> pluginScan;
+    bool pluginScanPending;
+    // Dirs unloaded once the scanned plugins are loaded
+    QStringList pluginDirsToRemove;
+
+    bool hibernating;
+    // Timing of the calls into plugins
+    MImPluginProfiler profiler;
+    // Plugin switches, by prewarmNeighboursEnabled()
+    SwitchStats switchStats[2];
+    // Managers (one per served display) alive and hibernating in this process
+    static int managerCount;
+    static int hibernatingManagers;
 };
 
 #endif
@@ -0,0 +1,182 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "mimpluginprofiler.h"
+#include "mimwidgetstate.h"
+
+#include <QDebug>
+#include <QStringList>
+
+const qint64 MImPluginProfiler::BucketLimits[] = {
+    100, 250, 500, 1000, 2000, 4000, 8000, 16000, 32000, 64000, 128000
+};
+
+MImPluginProfiler::Histogram::Histogram()
+    : count(0),
+      total(0),
+      max(0)
+{
+    for (int i = 0; i < BucketCount; ++i) {
+        buckets[i] = 0;
+    }
+}
+
+MImPluginProfiler::Call::Call(MImPluginProfiler &profiler,
+                              const MAbstractInputMethod *inputMethod,
+                              EntryPoint entryPoint)
+    : m_profiler(profiler),
+      m_inputMethod(inputMethod),
+      m_entryPoint(entryPoint)
+{
+    m_timer.start();
+}
+
+MImPluginProfiler::Call::~Call()
+{
+    m_profiler.record(m_inputMethod, m_entryPoint, m_timer.nsecsElapsed());
+}
+
+MImPluginProfiler::MImPluginProfiler()
+    : m_stallThreshold(0),
+      m_widgetState(0)
+{
+}
+
+void MImPluginProfiler::addInputMethod(const MAbstractInputMethod *inputMethod,
+                                       const QString &pluginId)
+{
+    m_stats[inputMethod].pluginId = pluginId;
+}
+
+void MImPluginProfiler::removeInputMethod(const MAbstractInputMethod *inputMethod)
+{
+    QHash<const MAbstractInputMethod *, PluginStats>::iterator i = m_stats.find(inputMethod);
+    if (i == m_stats.end()) {
+        return;
+    }
+    dump(i.value());
+    m_stats.erase(i);
+}
+
+void MImPluginProfiler::setStallThreshold(int msecs)
+{
+    m_stallThreshold = qint64(qMax(msecs, 0)) * 1000000;
+}
+
+void MImPluginProfiler::setWidgetState(const MImWidgetState *widgetState)
+{
+    m_widgetState = widgetState;
+}
+
+void MImPluginProfiler::record(const MAbstractInputMethod *inputMethod,
+                               EntryPoint entryPoint, qint64 nsecs)
+{
+    QHash<const MAbstractInputMethod *, PluginStats>::iterator i = m_stats.find(inputMethod);
+    if (i == m_stats.end()) {
+        return;
+    }
+
+    const qint64 usecs = nsecs / 1000;
+    Histogram &histogram = i->histograms[entryPoint];
+    int bucket = 0;
+    while (bucket < BucketCount - 1 && usecs > BucketLimits[bucket]) {
+        ++bucket;
+    }
+    ++histogram.buckets[bucket];
+    ++histogram.count;
+    histogram.total += usecs;
+    histogram.max = qMax(histogram.max, usecs);
+
+    if (m_stallThreshold > 0 && nsecs > m_stallThreshold) {
+        qWarning() << "Plugin stall:" << i->pluginId << entryPointName(entryPoint)
+                   << "took" << usecs / 1000.0 << "ms, widget state" << describeWidgetState();
+    }
+}
+
+void MImPluginProfiler::dump() const
+{
+    Q_FOREACH (const PluginStats &stats, m_stats) {
+        dump(stats);
+    }
+}
+
+void MImPluginProfiler::dump(const PluginStats &stats) const
+{
+    for (int entryPoint = 0; entryPoint < EntryPointCount; ++entryPoint) {
+        const Histogram &histogram = stats.histograms[entryPoint];
+        if (!histogram.count) {
+            continue;
+        }
+
+        QStringList buckets;
+        for (int bucket = 0; bucket < BucketCount; ++bucket) {
+            if (histogram.buckets[bucket]) {
+                const QString limit = bucket < BucketCount - 1
+                        ? QString("<=%1us").arg(BucketLimits[bucket])
+                        : QString(">%1us").arg(BucketLimits[BucketCount - 2]);
+                buckets.append(QString("%1:%2").arg(limit).arg(histogram.buckets[bucket]));
+            }
+        }
+
+        qInfo() << "Plugin calls:" << stats.pluginId << entryPointName(EntryPoint(entryPoint))
+                << "count" << histogram.count
+                << "avg" << histogram.total / histogram.count << "us"
+                << "max" << histogram.max << "us"
+                << qPrintable(buckets.join(" "));
+    }
+}
+
+QString MImPluginProfiler::describeWidgetState() const
+{
+    if (!m_widgetState) {
+        return QString("unknown");
+    }
+
+    // Text content is left out, only its size is reported
+    return QString("focus=%1 contentType=%2 enterKeyType=%3 inputMethodMode=%4 "
+                   "cursor=%5 textLength=%6 hidden=%7")
+            .arg(m_widgetState->focusState())
+            .arg(m_widgetState->contentType())
+            .arg(m_widgetState->enterKeyType())
+            .arg(m_widgetState->inputMethodMode())
+            .arg(m_widgetState->cursorPosition())
+            .arg(m_widgetState->surroundingText().length())
+            .arg(m_widgetState->hiddenText());
+}
+
+const char *MImPluginProfiler::entryPointName(EntryPoint entryPoint)
+{
+    switch (entryPoint) {
+    case ProcessKeyEvent:                   return "processKeyEvent";
+    case Update:                            return "update";
+    case ImExtensionEvent:                  return "imExtensionEvent";
+    case SetKeyOverrides:                   return "setKeyOverrides";
+    case Show:                              return "show";
+    case Hide:                              return "hide";
+    case SetState:                          return "setState";
+    case Reset:                             return "reset";
+    case SetPreedit:                        return "setPreedit";
+    case HandleFocusChange:                 return "handleFocusChange";
+    case HandleClientChange:                return "handleClientChange";
+    case HandleVisualizationPriorityChange: return "handleVisualizationPriorityChange";
+    case HandleAppOrientationChange:        return "handleAppOrientationChange";
+    case HandleMouseClickOnPreedit:         return "handleMouseClickOnPreedit";
+    case EntryPointCount:                   break;
+    }
+    return "unknown";
+}
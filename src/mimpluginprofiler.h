@@ -0,0 +1,123 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMPLUGINPROFILER_H
+#define MIMPLUGINPROFILER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QString>
+
+class MAbstractInputMethod;
+class MImWidgetState;
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief Times the calls made into input method plugins.
+ *
+ * Plugins run on the GUI thread, so a slow call delays Wayland dispatch for
+ * everything else. Every call wrapped in a Call is measured with the
+ * monotonic clock and counted in a histogram per plugin and entry point.
+ * Calls slower than the stall threshold are logged together with the widget
+ * state they were made for.
+ */
+class MImPluginProfiler
+{
+public:
+    enum EntryPoint {
+        ProcessKeyEvent,
+        Update,
+        ImExtensionEvent,
+        SetKeyOverrides,
+        Show,
+        Hide,
+        SetState,
+        Reset,
+        SetPreedit,
+        HandleFocusChange,
+        HandleClientChange,
+        HandleVisualizationPriorityChange,
+        HandleAppOrientationChange,
+        HandleMouseClickOnPreedit,
+        EntryPointCount
+    };
+
+    //! Measures one call from construction to destruction.
+    class Call
+    {
+    public:
+        Call(MImPluginProfiler &profiler, const MAbstractInputMethod *inputMethod,
+             EntryPoint entryPoint);
+        ~Call();
+
+    private:
+        Q_DISABLE_COPY(Call)
+
+        MImPluginProfiler &m_profiler;
+        const MAbstractInputMethod *m_inputMethod;
+        EntryPoint m_entryPoint;
+        QElapsedTimer m_timer;
+    };
+
+    MImPluginProfiler();
+
+    //! Calls of \a inputMethod are accounted to \a pluginId.
+    void addInputMethod(const MAbstractInputMethod *inputMethod, const QString &pluginId);
+    //! Logs and drops the histograms of \a inputMethod.
+    void removeInputMethod(const MAbstractInputMethod *inputMethod);
+
+    //! Calls taking longer than \a msecs are logged, 0 disables the logging.
+    void setStallThreshold(int msecs);
+    //! State of the focused widget, described in stall logs.
+    void setWidgetState(const MImWidgetState *widgetState);
+
+    //! Logs the histograms of all plugins.
+    void dump() const;
+
+    static const char *entryPointName(EntryPoint entryPoint);
+
+private:
+    // Upper bounds in microseconds; the last bucket is unbounded
+    enum { BucketCount = 12 };
+    static const qint64 BucketLimits[BucketCount - 1];
+
+    struct Histogram {
+        Histogram();
+
+        quint32 buckets[BucketCount];
+        quint32 count;
+        qint64 total; // microseconds
+        qint64 max;   // microseconds
+    };
+
+    struct PluginStats {
+        QString pluginId;
+        Histogram histograms[EntryPointCount];
+    };
+
+    void record(const MAbstractInputMethod *inputMethod, EntryPoint entryPoint, qint64 nsecs);
+    void dump(const PluginStats &stats) const;
+    QString describeWidgetState() const;
+
+    QHash<const MAbstractInputMethod *, PluginStats> m_stats;
+    qint64 m_stallThreshold; // nanoseconds
+    const MImWidgetState *m_widgetState;
+};
+//! \internal_end
+
+#endif // MIMPLUGINPROFILER_H
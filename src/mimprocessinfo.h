@@ -0,0 +1,33 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMPROCESSINFO_H
+#define MIMPROCESSINFO_H
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief Figures about the server process, for logging.
+ */
+namespace MImProcessInfo
+{
+    //! Resident set size of this process in kB, or -1
+    long residentSetSize();
+}
+//! \internal_end
+
+#endif // MIMPROCESSINFO_H
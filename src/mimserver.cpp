@@ -21,6 +21,12 @@
 #include "imelunaservice.h"
 #include "webosloginfo.h"
 
+namespace {
+    // The LS2 service name is per process, so the first server registers it
+    // and the others add their connection to it
+    QWeakPointer<IMELunaService> sharedLunaService;
+}
+
 class MImServerPrivate
 {
 public:
@@ -52,7 +58,13 @@ MImServer::MImServer(const QSharedPointer<MInputContextConnection> &icConnection
 
     d->icConnection = icConnection;
     d->pluginManager = new MIMPluginManager(d->icConnection, platform);
-    d->lunaService.reset(new IMELunaService(d->icConnection));
+    d->lunaService = sharedLunaService.toStrongRef();
+    if (d->lunaService) {
+        d->lunaService->addConnection(d->icConnection);
+    } else {
+        d->lunaService.reset(new IMELunaService(d->icConnection));
+        sharedLunaService = d->lunaService;
+    }
 
     webOSLogInfo("VKB_VERSION", "FRAMEWORK", MALIIT_VERSION);
 }
@@ -22,6 +22,7 @@
 #include <QtGlobal>
 #include <QDebug>
 #include <QList>
+#include <QStringList>
 #include <QExplicitlySharedDataPointer>
 #include <QSharedData>
 
@@ -34,6 +35,7 @@ namespace {
 
     CommandLineParameter AvailableConnectionParameters[] = {
         { "-instance",          "Set a numeric ID for this instance"},
+        { "-displays",          "Serve the given comma-separated display IDs from this process"},
         { "-no-ls2-service",    "Do not start ls2-service"}
     };
 
@@ -368,6 +370,26 @@ MImServerConnectionOptionsParser::parseParameter(const char *parameter,
                     }
                     *argumentCount = 0;
                 }
+            } else if (!strcmp(parameter, "-displays")) {
+                if (next) {
+                    const QStringList ids = QString::fromUtf8(next).split(QChar(','));
+                    Q_FOREACH (const QString &id, ids) {
+                        bool ok = false;
+                        const int displayId = id.trimmed().toInt(&ok);
+                        if (ok && !storage->displayIds.contains(displayId)) {
+                            storage->displayIds.append(displayId);
+                        } else if (!ok) {
+                            qWarning() << "Ignoring invalid display ID" << id;
+                        }
+                    }
+                    *argumentCount = 1;
+                } else {
+                    if (fprintf(stderr, "ERROR: No argument passed to -displays\n") < 0) {
+                        qDebug() << "failed to send formatted output to stream";
+                        return Invalid;
+                    }
+                    *argumentCount = 0;
+                }
             } else if (!strcmp(parameter, "-no-ls2-service")) {
                 storage->noLS2Service = true;
                 *argumentCount = 0;
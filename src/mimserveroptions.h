@@ -19,6 +19,7 @@
 
 #include <QtGlobal>
 #include <QString>
+#include <QList>
 
 //! \internal
 
@@ -41,6 +42,8 @@ public:
 
     //! Contains true if user asks for help or provided incorrect parameter
     int instanceId;
+    //! Displays served by this process, empty to serve only \a instanceId
+    QList<int> displayIds;
     bool noLS2Service;
 };
 
@@ -0,0 +1,136 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "mimserversnapshot.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace {
+    const quint32 SnapshotMagic = 0x4d535350; // "MSSP"
+    const quint32 SnapshotVersion = 1;
+}
+
+MImServerSnapshot::MImServerSnapshot(const QString &fileName)
+    : m_fileName(fileName)
+    , m_pluginDirs()
+    , m_keyboards()
+    , m_valid(false)
+    , m_dirty(false)
+{
+}
+
+bool MImServerSnapshot::load()
+{
+    m_valid = false;
+    m_dirty = false;
+
+    QFile file(m_fileName);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+
+    // A few hundred bytes, not worth mapping
+    const QByteArray bytes = file.readAll();
+    QDataStream stream(bytes);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QStringList pluginDirs;
+    QStringList keyboards;
+    stream >> magic >> version;
+    if (magic == SnapshotMagic && version == SnapshotVersion) {
+        stream >> pluginDirs >> keyboards;
+    }
+    const bool ok = magic == SnapshotMagic && version == SnapshotVersion
+                    && stream.status() == QDataStream::Ok;
+
+    if (!ok) {
+        qWarning() << "Ignoring server snapshot" << m_fileName << "with unknown format";
+        return false;
+    }
+
+    m_pluginDirs = pluginDirs;
+    m_keyboards = keyboards;
+    m_valid = true;
+    return true;
+}
+
+bool MImServerSnapshot::save()
+{
+    if (!m_dirty) {
+        return true;
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write server snapshot" << m_fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+    stream << SnapshotMagic << SnapshotVersion << m_pluginDirs << m_keyboards;
+
+    if (!file.commit()) {
+        qWarning() << "Failed to write server snapshot" << m_fileName << file.errorString();
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+bool MImServerSnapshot::isValid() const
+{
+    return m_valid;
+}
+
+QStringList MImServerSnapshot::pluginDirs() const
+{
+    return m_pluginDirs;
+}
+
+void MImServerSnapshot::setPluginDirs(const QStringList &pluginDirs)
+{
+    if (!m_valid || m_pluginDirs != pluginDirs) {
+        m_pluginDirs = pluginDirs;
+        m_valid = true;
+        m_dirty = true;
+    }
+}
+
+QStringList MImServerSnapshot::keyboards() const
+{
+    return m_keyboards;
+}
+
+void MImServerSnapshot::setKeyboards(const QStringList &keyboards)
+{
+    if (!m_valid || m_keyboards != keyboards) {
+        m_keyboards = keyboards;
+        m_dirty = true;
+    }
+}
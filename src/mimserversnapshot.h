@@ -0,0 +1,63 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMSERVERSNAPSHOT_H
+#define MIMSERVERSNAPSHOT_H
+
+#include <QString>
+#include <QStringList>
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief State derived by a previous server instance.
+ *
+ * A thin cache of the plugin dirs and keyboards derived from localeInfo:
+ * a respawned server loads the plugins of these dirs instead of waiting
+ * for the settings service, and reconciles once the live settings arrive.
+ */
+class MImServerSnapshot
+{
+public:
+    explicit MImServerSnapshot(const QString &fileName);
+
+    //! Reads the snapshot file. Returns false if it is missing or unreadable.
+    bool load();
+    //! Writes the snapshot file if it changed since load().
+    bool save();
+
+    //! Returns true if the snapshot was loaded or set.
+    bool isValid() const;
+
+    //! Sorted plugin dirs derived from localeInfo
+    QStringList pluginDirs() const;
+    void setPluginDirs(const QStringList &pluginDirs);
+
+    //! Keyboard languages of localeInfo
+    QStringList keyboards() const;
+    void setKeyboards(const QStringList &keyboards);
+
+private:
+    QString m_fileName;
+    QStringList m_pluginDirs;
+    QStringList m_keyboards;
+    bool m_valid;
+    bool m_dirty;
+};
+//! \internal_end
+
+#endif // MIMSERVERSNAPSHOT_H
@@ -24,12 +24,21 @@
 #include <QByteArray>
 #include <QVariant>
 #include <QDebug>
+#include <QHash>
+#include <QMetaMethod>
+#include <QPair>
 
 typedef MImSettingsLunaSettingsBackendFactory MImSettingsDefaultPersistentBackendFactory;
 
 QScopedPointer<MImSettingsBackendFactory> MImSettings::factory;
 MImSettings::SettingsType MImSettings::preferredSettingsType = MImSettings::InvalidSettings;
 
+namespace {
+    // Backends in use, by group and key
+    typedef QHash<QPair<int, QString>, QWeakPointer<MImSettingsBackend> > BackendCache;
+    BackendCache backendCache;
+}
+
 MImSettingsBackend::MImSettingsBackend(QObject *parent) :
     QObject(parent)
 {
@@ -43,6 +52,14 @@ MImSettingsBackendFactory::~MImSettingsBackendFactory()
 {
 }
 
+void MImSettingsBackendFactory::suspend()
+{
+}
+
+void MImSettingsBackendFactory::resume()
+{
+}
+
 QString MImSettings::key() const
 {
     return backend->key();
@@ -84,6 +101,9 @@ QList<QString> MImSettings::listEntries() const
 
 MImSettings::MImSettings(const QString &key, const Group group, QObject *parent)
     : QObject(parent)
+    , settingsKey(key)
+    , settingsGroup(group)
+    , backendConnected(false)
 {
     if (!factory) {
         MImSettingsBackendFactory *newFactory = 0;
@@ -111,34 +131,88 @@ MImSettings::MImSettings(const QString &key, const Group group, QObject *parent)
         MImSettings::setImplementationFactory(newFactory);
     }
 
-    backend.reset(factory->create(key, group, this));
-
-    connect(backend.data(), SIGNAL(valueChanged()), this, SIGNAL(valueChanged()));
+    const QPair<int, QString> cacheKey(group, key);
+    backend = backendCache.value(cacheKey).toStrongRef();
+    if (!backend) {
+        // Deleted later, as the last instance may go away while the
+        // backend emits valueChanged()
+        backend = QSharedPointer<MImSettingsBackend>(factory->create(key, group, 0),
+                                                     &QObject::deleteLater);
+        backendCache.insert(cacheKey, backend);
+    }
 }
 
 MImSettings::~MImSettings()
 {
+    if (backend.isNull()) {
+        return;
+    }
+
+    // Drop the cache entry together with the last strong reference
+    const QWeakPointer<MImSettingsBackend> shared(backend);
+    backend.clear();
+    if (shared.isNull()) {
+        const QPair<int, QString> cacheKey(settingsGroup, settingsKey);
+        if (backendCache.value(cacheKey).isNull()) {
+            backendCache.remove(cacheKey);
+        }
+    }
+}
+
+void MImSettings::connectNotify(const QMetaMethod &signal)
+{
+    if (!backendConnected && signal == QMetaMethod::fromSignal(&MImSettings::valueChanged)) {
+        backendConnected = true;
+        connect(backend.data(), SIGNAL(valueChanged()), this, SIGNAL(valueChanged()));
+    }
 }
 
 void MImSettings::setPreferredSettingsType(SettingsType setting)
 {
     preferredSettingsType = setting;
+    backendCache.clear();
     factory.reset();
 }
 
 void MImSettings::setImplementationFactory(MImSettingsBackendFactory *newFactory)
 {
+    // Backends of the previous factory are not shared with new instances
+    backendCache.clear();
     factory.reset(newFactory);
 }
 
-QHash<QString, QVariant> MImSettings::defaults()
+void MImSettings::suspendNotifications()
+{
+    if (factory) {
+        factory->suspend();
+    }
+}
+
+void MImSettings::resumeNotifications()
 {
-    QHash<QString, QVariant> defaults;
+    if (factory) {
+        factory->resume();
+    }
+}
+
+namespace {
+    QHash<QString, QVariant> buildDefaults()
+    {
+        QHash<QString, QVariant> defaults;
+
+        defaults[MALIIT_CONFIG_ROOT"plugins/hardware"] =
+            MALIIT_DEFAULT_HW_PLUGIN;
+        defaults[MALIIT_CONFIG_ROOT"accessoryenabled"] = false;
+        defaults[MALIIT_CONFIG_ROOT"multitouch/enabled"] = MALIIT_ENABLE_MULTITOUCH;
+
+        return defaults;
+    }
+}
 
-    defaults[MALIIT_CONFIG_ROOT"plugins/hardware"] =
-        MALIIT_DEFAULT_HW_PLUGIN;
-    defaults[MALIIT_CONFIG_ROOT"accessoryenabled"] = false;
-    defaults[MALIIT_CONFIG_ROOT"multitouch/enabled"] = MALIIT_ENABLE_MULTITOUCH;
+QHash<QString, QVariant> MImSettings::defaults()
+{
+    // Built once; callers get a shared copy
+    static const QHash<QString, QVariant> defaults(buildDefaults());
 
     return defaults;
 }
@@ -23,6 +23,7 @@
 #include <QStringList>
 #include <QObject>
 #include <QScopedPointer>
+#include <QSharedPointer>
 
 
 //! \internal
@@ -40,6 +41,10 @@
 
   Before making use of MImSettings, you must call MImSettings::setPreferredSettingsType().
 
+  All instances for the same key and group share one backend, which is
+  created with the first of them and released with the last, so a short
+  lived instance for a key that is in use elsewhere costs no backend.
+
   \warning MImSettings is not reentrant.
 */
 
@@ -146,13 +151,30 @@ public:
     */
     static QHash<QString, QVariant> defaults();
 
+    /*! Stops watching for changes made outside of this process, e.g. by
+        other services, until resumeNotifications() is called.
+    */
+    static void suspendNotifications();
+
+    /*! Watches for changes made outside of this process again. Changes
+        made meanwhile are notified through valueChanged().
+    */
+    static void resumeNotifications();
+
 Q_SIGNALS:
     /*! Emitted when the value of this item has changed.
      */
     void valueChanged();
 
+protected:
+    virtual void connectNotify(const QMetaMethod &signal);
+
 private:
-    QScopedPointer<MImSettingsBackend> backend;
+    QSharedPointer<MImSettingsBackend> backend;
+    QString settingsKey;
+    Group settingsGroup;
+    // valueChanged() of the backend is forwarded once someone listens
+    bool backendConnected;
     static QScopedPointer<MImSettingsBackendFactory> factory;
     static SettingsType preferredSettingsType;
 };
@@ -259,6 +281,16 @@ public:
     */
     virtual ~MImSettingsBackendFactory();
     virtual MImSettingsBackend *create(const QString &key, const MImSettings::Group group, QObject *parent) = 0;
+
+    /*! Stops watching for external changes until resume() is called.
+        The default implementation does nothing.
+    */
+    virtual void suspend();
+
+    /*! Watches for external changes again, after suspend().
+        The default implementation does nothing.
+    */
+    virtual void resume();
 };
 
 //! \internal_end
@@ -21,56 +21,60 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QSet>
+#include <QTimer>
 
 #include "webosloginfo.h"
 #include "mimglobalsettings.h"
 
 #include <QDebug>
 
-typedef QList<MImSettingsLunaSettingsBackendPrivate *> SettingsList;
+typedef QSet<MImSettingsLunaSettingsBackendPrivate *> SettingsSet;
+typedef QHash<QString, SettingsSet> SettingsHash;
 
-static SettingsList g_managerSettingsList;
-static SettingsList g_pluginSettingsList;
+// Backends by Luna key
+static SettingsHash g_managerSettings;
+static SettingsHash g_pluginSettings;
+
+// Last values received from Luna, kept in the persistent settings
+static const QString LastKnownRoot = "/maliit/lunasettings/";
 
 struct MImSettingsLunaSettingsBackendPrivate {
     MImSettingsLunaSettingsBackend* backend;
     QString key;
     MImSettings::Group group;
     QVariant value;
+    QSettings *cache;
 
     void setJsonValue(QVariant jsonValue)
     {
         if (value != jsonValue) {
             value = jsonValue;
+            // Written behind, together with other settings changes
+            if (cache && cache->value(LastKnownRoot + key) != jsonValue)
+                cache->setValue(LastKnownRoot + key, jsonValue);
             Q_EMIT backend->valueChanged();
         }
     }
 
+    SettingsHash &instances() const
+    {
+        return group == MImSettings::GroupManager ? g_managerSettings : g_pluginSettings;
+    }
+
     void registerInstance()
     {
-        switch (group) {
-        case MImSettings::GroupManager:
-            if (!g_managerSettingsList.contains(this))
-                g_managerSettingsList.append(this);
-            break;
-        case MImSettings::GroupPlugin:
-            if (!g_pluginSettingsList.contains(this))
-                g_pluginSettingsList.append(this);
-            break;
-        }
+        instances()[key].insert(this);
     }
 
     void unregisterInstance()
     {
-        switch (group) {
-        case MImSettings::GroupManager:
-            if (!g_managerSettingsList.contains(this))
-                g_managerSettingsList.append(this);
-            break;
-        case MImSettings::GroupPlugin:
-            if (g_pluginSettingsList.contains(this))
-                g_pluginSettingsList.removeOne(this);
-            break;
+        SettingsHash &hash = instances();
+        SettingsHash::iterator i = hash.find(key);
+        if (i != hash.end()) {
+            i->remove(this);
+            if (i->isEmpty())
+                hash.erase(i);
         }
     }
 };
@@ -111,7 +115,8 @@ QList<QString> MImSettingsLunaSettingsBackend::listEntries() const
     return QList<QString>();
 }
 
-MImSettingsLunaSettingsBackend::MImSettingsLunaSettingsBackend(const QString &key, const MImSettings::Group group, QObject *parent)
+MImSettingsLunaSettingsBackend::MImSettingsLunaSettingsBackend(const QString &key, const MImSettings::Group group, QObject *parent,
+                                                               QSettings *cache)
     : MImSettingsBackend(parent)
     , d_ptr(new MImSettingsLunaSettingsBackendPrivate)
 {
@@ -120,6 +125,11 @@ MImSettingsLunaSettingsBackend::MImSettingsLunaSettingsBackend(const QString &ke
     d->backend = this;
     d->key = key;
     d->group = group;
+    d->cache = cache;
+    // Start from the last known value instead of waiting for the service;
+    // the subscription then only notifies if the value really changed
+    if (cache)
+        d->value = cache->value(LastKnownRoot + key);
     d->registerInstance();
 }
 
@@ -130,19 +140,19 @@ MImSettingsLunaSettingsBackend::~MImSettingsLunaSettingsBackend()
     d->unregisterInstance();
 }
 
-static inline void processResponse(MImSettingsLunaSettingsBackendPrivate *d, QJsonObject &response)
+static inline void processResponse(const SettingsHash &instances, const QJsonObject &settings)
 {
-    QJsonObject::const_iterator it;
-    if ((it = response.find("settings")) != response.end()) {
-        QJsonObject settings = it.value().toObject();
-        QJsonObject::const_iterator ite = settings.find(d->key);
-        if (ite != settings.end())
-            d->setJsonValue(ite.value().toVariant());
-    } else if ((it = response.find("configs")) != response.end()) {
-        QJsonObject settings = it.value().toObject();
-        QJsonObject::const_iterator ite = settings.find(d->key);
-        if (ite != settings.end())
-            d->setJsonValue(ite.value().toVariant());
+    for (QJsonObject::const_iterator it = settings.constBegin(); it != settings.constEnd(); ++it) {
+        SettingsHash::const_iterator found = instances.constFind(it.key());
+        if (found == instances.constEnd())
+            continue;
+
+        const QVariant value = it.value().toVariant();
+        // Receivers may create or destroy backends
+        const SettingsSet backends = found.value();
+        Q_FOREACH (MImSettingsLunaSettingsBackendPrivate *d, backends) {
+            d->setJsonValue(value);
+        }
     }
 }
 
@@ -154,18 +164,21 @@ static bool getSystemSettingsCallback(LSHandle *handle, LSMessage *message, void
     if (message) {
         const char *jsonString = LSMessageGetPayload(message);
         if (jsonString) {
-            QJsonObject json = QJsonDocument::fromJson(jsonString).object();
+            const QJsonObject json = QJsonDocument::fromJson(jsonString).object();
 
             webOSLogInfo("SYSTEMSETTINGS", "STATE_CHANGE", jsonString);
 
-            // Deliver changes to manager first as it may affect plugins due to the change
-            SettingsList::iterator i;
-            for (i = g_managerSettingsList.begin(); i != g_managerSettingsList.end(); i++) {
-                processResponse(*i, json);
-            }
-            for (i = g_pluginSettingsList.begin(); i != g_pluginSettingsList.end(); i++) {
-                processResponse(*i, json);
+            QJsonObject::const_iterator it;
+            QJsonObject settings;
+            if ((it = json.find("settings")) != json.end()) {
+                settings = it.value().toObject();
+            } else if ((it = json.find("configs")) != json.end()) {
+                settings = it.value().toObject();
             }
+
+            // Deliver changes to manager first as it may affect plugins due to the change
+            processResponse(g_managerSettings, settings);
+            processResponse(g_pluginSettings, settings);
         }
     }
     return true;
@@ -178,34 +191,38 @@ static bool serverConnectCallback(LSHandle *handle, LSMessage *message, void *ct
     return factory->serverConnectCallback(handle, message, ctx);
 }
 
-struct LunaServiceRequestInfoMap {
-    const char *key;
+struct LunaServiceRequestInfo {
     const char *serviceUrl;
+    // %1 is replaced with the JSON array of keys
     const char *parameter;
 };
 
+// Keys sharing a request are subscribed together in one call
+static const LunaServiceRequestInfo g_lunaServiceRequestInfo[] = {
+    { "luna://com.webos.settingsservice/getSystemSettings",
+        "{\"subscribe\":true, \"keys\":%1}" },
+    { "luna://com.webos.settingsservice/getSystemSettings",
+        "{\"subscribe\":true, \"keys\":%1, \"category\":\"option\"}" },
+    { "luna://com.webos.service.config/getConfigs",
+        "{\"subscribe\":true, \"configNames\":%1}" },
+};
+
+struct LunaServiceRequestInfoMap {
+    const char *key;
+    int request; // index in g_lunaServiceRequestInfo
+};
+
 static const LunaServiceRequestInfoMap g_lunaServiceRequestInfoMap[] = {
-    { "localeInfo", "luna://com.webos.settingsservice/getSystemSettings",
-        "{\"subscribe\":true, \"keys\":[\"%1\"]}" },
-    { "country", "luna://com.webos.settingsservice/getSystemSettings",
-        "{\"subscribe\":true, \"keys\":[\"%1\"], \"category\":\"option\"}" },
-    { "com.webos.service.ime.timeout", "luna://com.webos.service.config/getConfigs",
-        "{\"subscribe\":true, \"configNames\":[\"%1\"]}" },
-    { "com.webos.service.ime.static", "luna://com.webos.service.config/getConfigs",
-        "{\"subscribe\":true, \"configNames\":[\"%1\"]}" },
-    { 0, 0, 0 }
+    { "localeInfo", 0 },
+    { "country", 1 },
+    { "com.webos.service.ime.timeout", 2 },
+    { "com.webos.service.ime.static", 2 },
+    { "com.webos.service.ime.hibernate", 2 },
+    { 0, 0 }
 };
 
 void MImSettingsLunaSettingsBackendFactory::subscribeSettings(const QString &key)
 {
-    bool ret;
-    LSError error;
-    LSErrorInit(&error);
-    LSMessageToken token;
-
-    if (m_subscriptionMap.contains(key) && m_subscriptionMap.value(key) != LSMESSAGE_TOKEN_INVALID)
-        return;
-
     const LunaServiceRequestInfoMap *map;
     for (map = g_lunaServiceRequestInfoMap; map->key != 0; map++)
         if (!key.compare(map->key))
@@ -216,46 +233,70 @@ void MImSettingsLunaSettingsBackendFactory::subscribeSettings(const QString &key
         return;
     }
 
-    QString parameter = QString(map->parameter).arg(map->key);
-    ret = LSCall(m_handle, map->serviceUrl, parameter.toUtf8().data(), getSystemSettingsCallback, this, &token, &error);
-
-    if (!ret) {
-        qWarning() << "failed LSCall " << map->serviceUrl << ": " << error.message;
+    Subscription &subscription = m_subscriptions[map->request];
+    if (subscription.keys.contains(key))
         return;
-    }
 
-    m_subscriptionMap.insert(key, token);
+    // The request is reissued with all its keys once the current batch of
+    // backends is created
+    subscription.keys.append(key);
+    cancelSubscription(subscription);
+    if (!m_flushTimer.isActive()) {
+        m_flushTimer.start();
+    }
 }
 
-void MImSettingsLunaSettingsBackendFactory::unsubscribeSettings(const QString &key)
+void MImSettingsLunaSettingsBackendFactory::initFlushTimer()
 {
-    LSError error;
-    LSErrorInit(&error);
-    LSMessageToken token;
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(0);
+    QObject::connect(&m_flushTimer, &QTimer::timeout, [this]() {
+        if (!m_suspended)
+            restoreSubscriptions();
+    });
+}
 
-    if (m_subscriptionMap.contains(key) && m_subscriptionMap.value(key) != LSMESSAGE_TOKEN_INVALID) {
-        token = (LSMessageToken)m_subscriptionMap.value(key);
-        LSCallCancel(m_handle, token, &error);
+void MImSettingsLunaSettingsBackendFactory::cancelSubscription(Subscription &subscription)
+{
+    if (subscription.token != LSMESSAGE_TOKEN_INVALID) {
+        LSError error;
+        LSErrorInit(&error);
+        LSCallCancel(m_handle, subscription.token, &error);
 
-        m_subscriptionMap.insert(key, LSMESSAGE_TOKEN_INVALID);
+        subscription.token = LSMESSAGE_TOKEN_INVALID;
     }
 }
 
 void MImSettingsLunaSettingsBackendFactory::unsubscribeAll()
 {
-    QMapIterator<QString, LSMessageToken> iter(m_subscriptionMap);
-    while (iter.hasNext()) {
-        iter.next();
-        unsubscribeSettings(iter.key());
+    QMap<int, Subscription>::iterator iter;
+    for (iter = m_subscriptions.begin(); iter != m_subscriptions.end(); ++iter) {
+        cancelSubscription(iter.value());
     }
 }
 
 void MImSettingsLunaSettingsBackendFactory::restoreSubscriptions()
 {
-    QMapIterator<QString, LSMessageToken> iter(m_subscriptionMap);
-    while (iter.hasNext()) {
-        iter.next();
-        subscribeSettings(iter.key());
+    QMap<int, Subscription>::iterator iter;
+    for (iter = m_subscriptions.begin(); iter != m_subscriptions.end(); ++iter) {
+        Subscription &subscription = iter.value();
+        if (subscription.token != LSMESSAGE_TOKEN_INVALID || subscription.keys.isEmpty())
+            continue;
+
+        const LunaServiceRequestInfo &request = g_lunaServiceRequestInfo[iter.key()];
+        const QByteArray keys = QJsonDocument(QJsonArray::fromStringList(subscription.keys)).toJson(QJsonDocument::Compact);
+        const QString parameter = QString(request.parameter).arg(QString::fromUtf8(keys));
+
+        LSError error;
+        LSErrorInit(&error);
+        LSMessageToken token;
+        if (!LSCall(m_handle, request.serviceUrl, parameter.toUtf8().data(), getSystemSettingsCallback, this, &token, &error)) {
+            qWarning() << "failed LSCall " << request.serviceUrl << ": " << error.message;
+            LSErrorFree(&error);
+            continue;
+        }
+
+        subscription.token = token;
     }
 }
 
@@ -276,7 +317,7 @@ bool MImSettingsLunaSettingsBackendFactory::serverConnectCallback(LSHandle *hand
     {
         unsubscribeAll();
         return false;
-    } else {
+    } else if (!m_suspended) {
         restoreSubscriptions();
     }
 
@@ -319,7 +360,7 @@ void MImSettingsLunaSettingsBackendFactory::unregisterService()
 {
     if (m_handle) {
         unsubscribeAll();
-        m_subscriptionMap.clear();
+        m_subscriptions.clear();
 
         LSError error;
         LSErrorInit(&error);
@@ -329,20 +370,24 @@ void MImSettingsLunaSettingsBackendFactory::unregisterService()
 }
 
 MImSettingsLunaSettingsBackendFactory::MImSettingsLunaSettingsBackendFactory()
-    : MImSettingsQSettingsBackendFactory()
+    : MImSettingsQSettingsBackendFactory(),
+      m_suspended(false)
 {
     m_mainCtx = g_main_context_default();
     m_mainLoop = g_main_loop_new(m_mainCtx, TRUE);
 
+    initFlushTimer();
     registerService();
 }
 
 MImSettingsLunaSettingsBackendFactory::MImSettingsLunaSettingsBackendFactory(const QString &organization, const QString &application)
-    : MImSettingsQSettingsBackendFactory(organization, application)
+    : MImSettingsQSettingsBackendFactory(organization, application),
+      m_suspended(false)
 {
     m_mainCtx = g_main_context_default();
     m_mainLoop = g_main_loop_new(m_mainCtx, TRUE);
 
+    initFlushTimer();
     registerService();
 }
 
@@ -351,6 +396,24 @@ MImSettingsLunaSettingsBackendFactory::~MImSettingsLunaSettingsBackendFactory()
     unregisterService();
 }
 
+void MImSettingsLunaSettingsBackendFactory::suspend()
+{
+    // Subscriptions are kept in m_subscriptions with invalid tokens
+    m_suspended = true;
+    unsubscribeAll();
+
+    MImSettingsQSettingsBackendFactory::suspend();
+}
+
+void MImSettingsLunaSettingsBackendFactory::resume()
+{
+    // Subscribing again delivers the current values
+    m_suspended = false;
+    restoreSubscriptions();
+
+    MImSettingsQSettingsBackendFactory::resume();
+}
+
 static const char *ACCESSORY_ENABLED = "/maliit/accessoryenabled";
 static const char *ONSCREEN_ACTIVE = "/maliit/onscreen/active";
 static const char *CURRENT_LANGUAGE = "/maliit/onscreen/currentlanguage";
@@ -360,21 +423,25 @@ MImSettingsBackend *MImSettingsLunaSettingsBackendFactory::create(const QString
     qInfo() << "Creating MImSettingsBackend for" << key;
 
     if (key.endsWith("localeInfo")) {
-        MImSettingsBackend *settings = new MImSettingsLunaSettingsBackend("localeInfo", group, parent);
+        MImSettingsBackend *backend = new MImSettingsLunaSettingsBackend("localeInfo", group, parent, settings());
         subscribeSettings("localeInfo");
-        return settings;
+        return backend;
     } else if (key.endsWith("country")) {
-        MImSettingsBackend *settings = new MImSettingsLunaSettingsBackend("country", group, parent);
+        MImSettingsBackend *backend = new MImSettingsLunaSettingsBackend("country", group, parent, settings());
         subscribeSettings("country");
-        return settings;
+        return backend;
     } else if (key.endsWith("timeout")) {
-        MImSettingsBackend *settings = new MImSettingsLunaSettingsBackend("com.webos.service.ime.timeout", group, parent);
+        MImSettingsBackend *backend = new MImSettingsLunaSettingsBackend("com.webos.service.ime.timeout", group, parent, settings());
         subscribeSettings("com.webos.service.ime.timeout");
-        return settings;
+        return backend;
     } else if (key.endsWith("static")) {
-        MImSettingsBackend *settings = new MImSettingsLunaSettingsBackend("com.webos.service.ime.static", group, parent);
+        MImSettingsBackend *backend = new MImSettingsLunaSettingsBackend("com.webos.service.ime.static", group, parent, settings());
         subscribeSettings("com.webos.service.ime.static");
-        return settings;
+        return backend;
+    } else if (key.endsWith("hibernate")) {
+        MImSettingsBackend *backend = new MImSettingsLunaSettingsBackend("com.webos.service.ime.hibernate", group, parent, settings());
+        subscribeSettings("com.webos.service.ime.hibernate");
+        return backend;
     } else if (key.endsWith("currentLanguage")) {
         return MImSettingsQSettingsBackendFactory::create(CURRENT_LANGUAGE, group, parent);
     } else if (key.endsWith("accessoryenabled")) {
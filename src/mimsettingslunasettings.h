@@ -21,6 +21,8 @@
 
 #include <luna-service2/lunaservice.h>
 #include <QMap>
+#include <QStringList>
+#include <QTimer>
 
 #include "mimsettingsqsettings.h"
 
@@ -30,7 +32,11 @@ class MImSettingsLunaSettingsBackend : public MImSettingsBackend
 {
     Q_OBJECT
 public:
-    explicit MImSettingsLunaSettingsBackend(const QString &key, const MImSettings::Group group, QObject *parent = 0);
+    /*! The last value received for \a key is kept in \a cache, if given, and
+        seeds the backend until the settings service answers.
+    */
+    explicit MImSettingsLunaSettingsBackend(const QString &key, const MImSettings::Group group, QObject *parent = 0,
+                                            QSettings *cache = 0);
     virtual ~MImSettingsLunaSettingsBackend();
     virtual QString key() const;
     virtual QVariant value(const QVariant &def) const;
@@ -55,6 +61,8 @@ public:
     MImSettingsLunaSettingsBackendFactory(const MImSettingsLunaSettingsBackendFactory&) = delete;
     MImSettingsLunaSettingsBackendFactory &operator=(const MImSettingsLunaSettingsBackendFactory&) = delete;
     virtual MImSettingsBackend *create(const QString &key, const MImSettings::Group group, QObject *parent);
+    virtual void suspend();
+    virtual void resume();
 
     bool serverConnectCallback(LSHandle *handle, LSMessage *message, void *ctx);
 
@@ -62,15 +70,28 @@ private:
     void registerService();
     void unregisterService();
 
+    //! One subscription per service request, covering all its keys
+    struct Subscription {
+        Subscription() : token(LSMESSAGE_TOKEN_INVALID) {}
+
+        QStringList keys;
+        LSMessageToken token;
+    };
+
     void subscribeSettings(const QString &key);
-    void unsubscribeSettings(const QString &key);
+    void cancelSubscription(Subscription &subscription);
     void unsubscribeAll();
     void restoreSubscriptions();
+    void initFlushTimer();
 
     GMainContext *m_mainCtx;
     GMainLoop *m_mainLoop;
     LSHandle *m_handle;
-    QMap <QString, LSMessageToken> m_subscriptionMap;
+    // Keyed by the index of the service request
+    QMap<int, Subscription> m_subscriptions;
+    bool m_suspended;
+    // Subscribes a batch of new keys; owned, so a pending flush dies with the factory
+    QTimer m_flushTimer;
 };
 
 #endif // MIMSETTINGSLUNASETTINGS_H
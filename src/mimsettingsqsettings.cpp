@@ -16,8 +16,11 @@
 #include "mimsettingsqsettings.h"
 #include "config.h"
 
+#include <QCoreApplication>
+#include <QDebug>
 #include <QSettings>
 #include <QPointer>
+#include <QTimerEvent>
 
 
 typedef QList<MImSettingsQSettingsBackend *> Items;
@@ -28,6 +31,16 @@ namespace
     const QString Organization = "maliit.org";
     const QString Application = "server";
 
+    // Changes are written to server.conf at most once per this many ms
+    const int DefaultWriteDelay = 2000;
+
+    int writeDelay()
+    {
+        bool ok = false;
+        const int delay = qgetenv("MALIIT_SETTINGS_WRITE_DELAY").toInt(&ok);
+        return ok && delay >= 0 ? delay : DefaultWriteDelay;
+    }
+
     QList<QString> makeAbsolute(const QString &prefix, const QList<QString> &entries)
     {
         QList<QString> absolute;
@@ -45,6 +58,9 @@ struct MImSettingsQSettingsBackendPrivate {
     QString key;
     static ItemMap registry;
     QSettings *settingsInstance;
+    MImSettingsSnapshot *snapshot;
+    // key as stored by QSettings and the snapshot
+    QString snapshotKey;
 
     void registerInstance(MImSettingsQSettingsBackend *instance)
     {
@@ -93,6 +109,12 @@ QVariant MImSettingsQSettingsBackend::value(const QVariant &def) const
 {
     Q_D(const MImSettingsQSettingsBackend);
 
+    if (d->snapshot && d->snapshot->isValid()) {
+        QVariant value;
+        if (d->snapshot->value(d->snapshotKey, &value))
+            return value;
+    }
+
     if (!d->settingsInstance->contains(d->key))
         return MImSettings::defaults().value(d->key, def);
 
@@ -107,6 +129,8 @@ void MImSettingsQSettingsBackend::set(const QVariant &val)
         return;
 
     d->settingsInstance->setValue(d->key, val);
+    if (d->snapshot)
+        d->snapshot->invalidate();
     d->notify();
 }
 
@@ -118,6 +142,8 @@ void MImSettingsQSettingsBackend::unset()
         return;
 
     d->settingsInstance->remove(d->key);
+    if (d->snapshot)
+        d->snapshot->invalidate();
     d->notify();
 }
 
@@ -143,7 +169,8 @@ QList<QString> MImSettingsQSettingsBackend::listEntries() const
     return result;
 }
 
-MImSettingsQSettingsBackend::MImSettingsQSettingsBackend(QSettings *settingsInstance, const QString &key, QObject *parent) :
+MImSettingsQSettingsBackend::MImSettingsQSettingsBackend(QSettings *settingsInstance, const QString &key, QObject *parent,
+                                                         MImSettingsSnapshot *snapshot) :
     MImSettingsBackend(parent),
     d_ptr(new MImSettingsQSettingsBackendPrivate)
 {
@@ -151,6 +178,9 @@ MImSettingsQSettingsBackend::MImSettingsQSettingsBackend(QSettings *settingsInst
 
     d->key = key;
     d->settingsInstance = settingsInstance;
+    d->snapshot = snapshot;
+    if (snapshot)
+        d->snapshotKey = MImSettingsSnapshot::normalizedKey(key);
     d->registerInstance(this);
 }
 
@@ -161,15 +191,87 @@ MImSettingsQSettingsBackend::~MImSettingsQSettingsBackend()
     d->unregisterInstance(this);
 }
 
+MImWriteBehindSettings::MImWriteBehindSettings(const QString &fileName, QSettings::Format format,
+                                               int writeDelay)
+    : QSettings(fileName, format),
+      mWriteDelay(writeDelay),
+      mSnapshot(fileName + ".snapshot", fileName)
+{
+    if (QCoreApplication::instance()) {
+        connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit,
+                this, &MImWriteBehindSettings::flush);
+    }
+
+    // Another instance may have compiled the current file already
+    if (!mSnapshot.load()) {
+        mSnapshot.write(*this);
+    }
+}
+
+MImWriteBehindSettings::~MImWriteBehindSettings()
+{
+    // ~QSettings writes whatever is still pending
+}
+
+MImSettingsSnapshot *MImWriteBehindSettings::snapshot()
+{
+    return &mSnapshot;
+}
+
+void MImWriteBehindSettings::flush()
+{
+    mWriteTimer.stop();
+    // QSettings writes through a temporary file renamed over the original
+    sync();
+    if (status() != QSettings::NoError) {
+        qWarning() << "Failed to write settings to" << fileName();
+        return;
+    }
+    // sync() also reads changes made by other instances
+    mSnapshot.refresh();
+    if (!mSnapshot.isValid()) {
+        mSnapshot.write(*this);
+    }
+}
+
+bool MImWriteBehindSettings::event(QEvent *event)
+{
+    // QSettings posts UpdateRequest on the first change after a write and
+    // writes the file when it arrives. Defer that write instead; changes
+    // made meanwhile do not post again until sync() has run.
+    if (event->type() == QEvent::UpdateRequest) {
+        if (mWriteDelay <= 0) {
+            flush();
+        } else if (!mWriteTimer.isActive()) {
+            mWriteTimer.start(mWriteDelay, this);
+        }
+        return true;
+    }
+
+    return QSettings::event(event);
+}
+
+void MImWriteBehindSettings::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != mWriteTimer.timerId()) {
+        QSettings::timerEvent(event);
+        return;
+    }
+
+    flush();
+}
+
 /* QSettings backend backed by the native settings store for the Maliit Server org. and app. */
 #define QSETTINGS_FILE_NAME "server.conf"
 MImSettingsQSettingsBackendFactory::MImSettingsQSettingsBackendFactory()
-    : mSettings(QString(MALIIT_DATA_DIR) + "/" + QString(QSETTINGS_FILE_NAME), QSettings::IniFormat)
+    : mSettings(QString(MALIIT_DATA_DIR) + "/" + QString(QSETTINGS_FILE_NAME), QSettings::IniFormat,
+                writeDelay())
 {}
 
 MImSettingsQSettingsBackendFactory::MImSettingsQSettingsBackendFactory(const QString &organization,
                                                                        const QString &application)
-    : mSettings(QString(MALIIT_DATA_DIR) + "/" + QString(QSETTINGS_FILE_NAME), QSettings::IniFormat)
+    : mSettings(QString(MALIIT_DATA_DIR) + "/" + QString(QSETTINGS_FILE_NAME), QSettings::IniFormat,
+                writeDelay())
 {
     Q_UNUSED(organization);
     Q_UNUSED(application);
@@ -179,11 +281,26 @@ MImSettingsQSettingsBackendFactory::~MImSettingsQSettingsBackendFactory()
 {
 }
 
+void MImSettingsQSettingsBackendFactory::suspend()
+{
+    mSettings.flush();
+}
+
+void MImSettingsQSettingsBackendFactory::resume()
+{
+    mSettings.snapshot()->refresh();
+}
+
+QSettings *MImSettingsQSettingsBackendFactory::settings()
+{
+    return &mSettings;
+}
+
 MImSettingsBackend *MImSettingsQSettingsBackendFactory::create(const QString &key, const MImSettings::Group group, QObject *parent)
 {
     Q_UNUSED(group);
 
-    return new MImSettingsQSettingsBackend(&mSettings, key, parent);
+    return new MImSettingsQSettingsBackend(&mSettings, key, parent, mSettings.snapshot());
 }
 
 /* QSettings backend backed by a temporary file */
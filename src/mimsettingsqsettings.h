@@ -17,7 +17,9 @@
 #define MIMSETTINGSQSETTINGS_H
 
 #include "mimsettings.h"
+#include "mimsettingssnapshot.h"
 
+#include <QBasicTimer>
 #include <QScopedPointer>
 #include <QSettings>
 #include <QTemporaryFile>
@@ -31,7 +33,9 @@ class MImSettingsQSettingsBackend : public MImSettingsBackend
     Q_OBJECT
 
 public:
-    explicit MImSettingsQSettingsBackend(QSettings *settingsInstance, const QString &key, QObject *parent = 0);
+    //! Reads are answered from \a snapshot while it is valid, if given.
+    explicit MImSettingsQSettingsBackend(QSettings *settingsInstance, const QString &key, QObject *parent = 0,
+                                         MImSettingsSnapshot *snapshot = 0);
     virtual ~MImSettingsQSettingsBackend();
 
     virtual QString key() const;
@@ -51,6 +55,38 @@ private:
 
 //! \internal
 
+/*! \brief QSettings that delays writing changes to disk.
+ *
+ * Values are kept in memory and readers see them at once. The file is
+ * written, atomically, at most once per write delay, however many values
+ * changed in between, and before the application quits. Each write also
+ * recompiles the snapshot() of the file.
+ */
+class MImWriteBehindSettings : public QSettings
+{
+    Q_OBJECT
+
+public:
+    explicit MImWriteBehindSettings(const QString &fileName, QSettings::Format format,
+                                    int writeDelay);
+    virtual ~MImWriteBehindSettings();
+
+    MImSettingsSnapshot *snapshot();
+
+    //! Writes pending changes and the snapshot now.
+    void flush();
+
+protected:
+    virtual bool event(QEvent *event);
+    virtual void timerEvent(QTimerEvent *event);
+
+private:
+    int mWriteDelay; // ms
+    QBasicTimer mWriteTimer;
+    MImSettingsSnapshot mSnapshot;
+};
+
+
 class MImSettingsQSettingsBackendFactory : public MImSettingsBackendFactory
 {
 public:
@@ -59,9 +95,17 @@ public:
                                                 const QString &application);
     virtual ~MImSettingsQSettingsBackendFactory();
     virtual MImSettingsBackend *create(const QString &key, const MImSettings::Group group, QObject *parent);
+    //! Writes pending changes before the server goes idle.
+    virtual void suspend();
+    //! Picks up a snapshot rewritten meanwhile by another instance.
+    virtual void resume();
+
+protected:
+    //! The persistent settings file, for subclasses keeping state in it.
+    QSettings *settings();
 
 private:
-    QSettings mSettings;
+    MImWriteBehindSettings mSettings;
 };
 
 class MImSettingsQSettingsTemporaryBackendFactory : public MImSettingsBackendFactory
@@ -0,0 +1,464 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#include "mimsettingssnapshot.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStringList>
+#include <QVector>
+
+#include <algorithm>
+#include <string.h>
+
+namespace {
+    const quint32 SnapshotMagic = 0x4d534b56; // "MSKV"
+    const quint32 SnapshotVersion = 2;
+
+    enum ValueType {
+        BoolValue,
+        IntValue,        // Int or LongLong, as told by variantType
+        DoubleValue,
+        StringValue,     // value is offset << 32 | length
+        StringListValue, // value is offset << 32 | count of (offset, length) pairs
+        VariantValue     // value is offset << 32 | size of a QDataStream blob
+    };
+
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint64 generation;
+        qint64 sourceModified; // msecs since epoch
+        qint64 sourceSize;
+        quint32 count;
+        quint32 reserved;
+    };
+
+    struct Entry {
+        quint32 keyOffset;
+        quint32 keyLength;
+        quint32 type;
+        quint32 variantType; // QVariant::Type the value was read as
+        quint64 value;
+    };
+
+    quint64 packRef(quint32 offset, quint32 length)
+    {
+        return (quint64(offset) << 32) | length;
+    }
+
+    quint32 refOffset(quint64 value) { return quint32(value >> 32); }
+    quint32 refLength(quint64 value) { return quint32(value); }
+
+    //! String pool placed after the entries; equal strings are stored once
+    class Pool
+    {
+    public:
+        explicit Pool(quint32 base) : m_base(base) {}
+
+        quint32 addString(const QString &string)
+        {
+            QHash<QString, quint32>::const_iterator interned = m_strings.constFind(string);
+            if (interned != m_strings.constEnd()) {
+                return interned.value();
+            }
+            const quint32 offset = append(reinterpret_cast<const char *>(string.constData()),
+                                          string.size() * sizeof(QChar));
+            m_strings.insert(string, offset);
+            return offset;
+        }
+
+        quint32 addStringList(const QStringList &list)
+        {
+            QVector<quint32> refs;
+            Q_FOREACH (const QString &string, list) {
+                refs << addString(string) << quint32(string.size());
+            }
+            return append(reinterpret_cast<const char *>(refs.constData()),
+                          refs.size() * sizeof(quint32));
+        }
+
+        quint32 addBlob(const QByteArray &blob)
+        {
+            return append(blob.constData(), blob.size());
+        }
+
+        const QByteArray &data() const { return m_data; }
+
+    private:
+        quint32 append(const char *data, int size)
+        {
+            // Keep every item 4-byte aligned
+            while (m_data.size() % 4) {
+                m_data.append('\0');
+            }
+            const quint32 offset = m_base + m_data.size();
+            m_data.append(data, size);
+            return offset;
+        }
+
+        quint32 m_base;
+        QByteArray m_data;
+        QHash<QString, quint32> m_strings;
+    };
+
+    bool stampSource(const QString &sourceFileName, qint64 *modified, qint64 *size)
+    {
+        const QFileInfo info(sourceFileName);
+        if (!info.exists()) {
+            *modified = 0;
+            *size = 0;
+            return false;
+        }
+        *modified = info.lastModified().toMSecsSinceEpoch();
+        *size = info.size();
+        return true;
+    }
+
+    bool readHeader(const QString &fileName, Header *header)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly)
+               && file.read(reinterpret_cast<char *>(header), sizeof(Header)) == qint64(sizeof(Header))
+               && header->magic == SnapshotMagic && header->version == SnapshotVersion;
+    }
+}
+
+MImSettingsSnapshot::MImSettingsSnapshot(const QString &fileName, const QString &sourceFileName)
+    : m_fileName(fileName)
+    , m_sourceFileName(sourceFileName)
+    , m_file(fileName)
+    , m_data(0)
+    , m_size(0)
+    , m_generation(0)
+    , m_valid(false)
+    , m_stale(false)
+{
+}
+
+MImSettingsSnapshot::~MImSettingsSnapshot()
+{
+    unmap();
+}
+
+void MImSettingsSnapshot::unmap()
+{
+    if (m_data) {
+        m_file.unmap(const_cast<uchar *>(m_data));
+        m_data = 0;
+    }
+    m_file.close();
+    m_size = 0;
+    m_valid = false;
+}
+
+bool MImSettingsSnapshot::isCurrent(quint64 generation) const
+{
+    Header header;
+    if (!readHeader(m_fileName, &header)) {
+        return false;
+    }
+
+    qint64 modified = 0;
+    qint64 size = 0;
+    stampSource(m_sourceFileName, &modified, &size);
+    return header.generation == generation
+           && header.sourceModified == modified && header.sourceSize == size;
+}
+
+bool MImSettingsSnapshot::load()
+{
+    unmap();
+
+    if (!m_file.open(QIODevice::ReadOnly) || m_file.size() < qint64(sizeof(Header))) {
+        m_file.close();
+        return false;
+    }
+
+    m_size = m_file.size();
+    m_data = m_file.map(0, m_size);
+    if (!m_data) {
+        qWarning() << "Failed to map settings snapshot" << m_fileName << m_file.errorString();
+        unmap();
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header *>(m_data);
+    qint64 modified = 0;
+    qint64 size = 0;
+    stampSource(m_sourceFileName, &modified, &size);
+
+    bool ok = header->magic == SnapshotMagic && header->version == SnapshotVersion
+              && header->count <= (m_size - sizeof(Header)) / sizeof(Entry);
+
+    // Checked once here, so lookups can trust the offsets
+    const Entry *entries = reinterpret_cast<const Entry *>(m_data + sizeof(Header));
+    for (quint32 i = 0; ok && i < header->count; ++i) {
+        const Entry &entry = entries[i];
+        ok = entry.keyOffset % 2 == 0
+             && qint64(entry.keyOffset) + qint64(entry.keyLength) * 2 <= m_size;
+        if (ok && entry.type == StringValue) {
+            ok = refOffset(entry.value) % 2 == 0
+                 && qint64(refOffset(entry.value)) + qint64(refLength(entry.value)) * 2 <= m_size;
+        } else if (ok && entry.type == StringListValue) {
+            ok = refOffset(entry.value) % 4 == 0
+                 && qint64(refOffset(entry.value)) + qint64(refLength(entry.value)) * 8 <= m_size;
+            const quint32 *refs = reinterpret_cast<const quint32 *>(m_data + refOffset(entry.value));
+            for (quint32 j = 0; ok && j < refLength(entry.value); ++j) {
+                ok = refs[2 * j] % 2 == 0
+                     && qint64(refs[2 * j]) + qint64(refs[2 * j + 1]) * 2 <= m_size;
+            }
+        } else if (ok && entry.type == VariantValue) {
+            ok = qint64(refOffset(entry.value)) + qint64(refLength(entry.value)) <= m_size;
+        } else if (ok) {
+            ok = entry.type <= DoubleValue;
+        }
+    }
+
+    if (!ok) {
+        qWarning() << "Ignoring settings snapshot" << m_fileName << "with unknown format";
+        unmap();
+        return false;
+    }
+
+    m_generation = header->generation;
+    m_valid = header->sourceModified == modified && header->sourceSize == size;
+    return m_valid;
+}
+
+bool MImSettingsSnapshot::write(const QSettings &settings)
+{
+    QStringList keys = settings.allKeys();
+    // Ordinal UTF-16 order, as compared by value()
+    std::sort(keys.begin(), keys.end());
+
+    const quint32 entriesSize = keys.size() * sizeof(Entry);
+    Pool pool(sizeof(Header) + entriesSize);
+    QVector<Entry> entries(keys.size());
+
+    for (int i = 0; i < keys.size(); ++i) {
+        const QString &key = keys.at(i);
+        const QVariant value = settings.value(key);
+        Entry &entry = entries[i];
+
+        entry.keyOffset = pool.addString(key);
+        entry.keyLength = key.size();
+        entry.variantType = value.type();
+
+        switch (value.type()) {
+        case QVariant::Bool:
+            entry.type = BoolValue;
+            entry.value = value.toBool();
+            break;
+        case QVariant::Int:
+        case QVariant::LongLong:
+            entry.type = IntValue;
+            entry.value = quint64(value.toLongLong());
+            break;
+        case QVariant::Double: {
+            const double number = value.toDouble();
+            entry.type = DoubleValue;
+            memcpy(&entry.value, &number, sizeof(number));
+            break;
+        }
+        case QVariant::String: {
+            const QString string = value.toString();
+            entry.type = StringValue;
+            entry.value = packRef(pool.addString(string), string.size());
+            break;
+        }
+        case QVariant::StringList: {
+            const QStringList list = value.toStringList();
+            entry.type = StringListValue;
+            entry.value = packRef(pool.addStringList(list), list.size());
+            break;
+        }
+        default: {
+            QByteArray blob;
+            QDataStream stream(&blob, QIODevice::WriteOnly);
+            stream.setVersion(QDataStream::Qt_5_0);
+            stream << value;
+            entry.type = VariantValue;
+            entry.value = packRef(pool.addBlob(blob), blob.size());
+            break;
+        }
+        }
+    }
+
+    Header header;
+    header.magic = SnapshotMagic;
+    header.version = SnapshotVersion;
+    header.count = keys.size();
+    header.reserved = 0;
+    stampSource(m_sourceFileName, &header.sourceModified, &header.sourceSize);
+
+    // Continue the generation of a snapshot written by another process
+    Header previous;
+    header.generation = qMax(m_generation,
+                             readHeader(m_fileName, &previous) ? previous.generation : 0) + 1;
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    QSaveFile file(m_fileName);
+    if (!file.open(QIODevice::WriteOnly)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != qint64(sizeof(header))
+        || file.write(reinterpret_cast<const char *>(entries.constData()), entriesSize) != qint64(entriesSize)
+        || file.write(pool.data()) != pool.data().size()
+        || !file.commit()) {
+        qWarning() << "Failed to write settings snapshot" << m_fileName << file.errorString();
+        unmap();
+        return false;
+    }
+
+    m_stale = false;
+    return load();
+}
+
+void MImSettingsSnapshot::refresh()
+{
+    // A pending local write replaces the snapshot anyway
+    if (m_stale) {
+        return;
+    }
+    if (!m_valid || !isCurrent(m_generation)) {
+        load();
+    }
+}
+
+bool MImSettingsSnapshot::isValid() const
+{
+    return m_valid && !m_stale;
+}
+
+void MImSettingsSnapshot::invalidate()
+{
+    m_stale = true;
+}
+
+quint64 MImSettingsSnapshot::generation() const
+{
+    return m_generation;
+}
+
+QString MImSettingsSnapshot::normalizedKey(const QString &key)
+{
+    // Same rules as QSettings: '\\' is a separator, empty sections are
+    // dropped, and there is no leading or trailing '/'
+    QString normalized;
+    normalized.reserve(key.size());
+    bool separator = false;
+    Q_FOREACH (QChar c, key) {
+        if (c == QLatin1Char('/') || c == QLatin1Char('\\')) {
+            separator = true;
+            continue;
+        }
+        if (separator && !normalized.isEmpty()) {
+            normalized.append(QLatin1Char('/'));
+        }
+        separator = false;
+        normalized.append(c);
+    }
+    return normalized;
+}
+
+bool MImSettingsSnapshot::value(const QString &key, QVariant *value) const
+{
+    if (!isValid()) {
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header *>(m_data);
+    const Entry *entries = reinterpret_cast<const Entry *>(m_data + sizeof(Header));
+    const ushort *keyChars = key.utf16();
+    const int keyLength = key.size();
+
+    int low = 0;
+    int high = int(header->count) - 1;
+    while (low <= high) {
+        const int middle = (low + high) / 2;
+        const Entry &entry = entries[middle];
+        const ushort *entryChars = reinterpret_cast<const ushort *>(m_data + entry.keyOffset);
+        const int length = qMin(int(entry.keyLength), keyLength);
+
+        int compare = 0;
+        for (int i = 0; i < length && !compare; ++i) {
+            compare = int(entryChars[i]) - int(keyChars[i]);
+        }
+        if (!compare) {
+            compare = int(entry.keyLength) - keyLength;
+        }
+
+        if (compare < 0) {
+            low = middle + 1;
+        } else if (compare > 0) {
+            high = middle - 1;
+        } else {
+            switch (entry.type) {
+            case BoolValue:
+                *value = QVariant(entry.value != 0);
+                break;
+            case IntValue:
+                if (entry.variantType == QVariant::Int) {
+                    *value = QVariant(int(qlonglong(entry.value)));
+                } else {
+                    *value = QVariant(qlonglong(entry.value));
+                }
+                break;
+            case DoubleValue: {
+                double number;
+                memcpy(&number, &entry.value, sizeof(number));
+                *value = QVariant(number);
+                break;
+            }
+            case StringValue:
+                *value = QString(reinterpret_cast<const QChar *>(m_data + refOffset(entry.value)),
+                                 refLength(entry.value));
+                break;
+            case StringListValue: {
+                const quint32 *refs = reinterpret_cast<const quint32 *>(m_data + refOffset(entry.value));
+                QStringList list;
+                list.reserve(refLength(entry.value));
+                for (quint32 i = 0; i < refLength(entry.value); ++i) {
+                    list.append(QString(reinterpret_cast<const QChar *>(m_data + refs[2 * i]),
+                                        refs[2 * i + 1]));
+                }
+                *value = list;
+                break;
+            }
+            default: {
+                const QByteArray blob = QByteArray::fromRawData(
+                            reinterpret_cast<const char *>(m_data + refOffset(entry.value)),
+                            refLength(entry.value));
+                QDataStream stream(blob);
+                stream.setVersion(QDataStream::Qt_5_0);
+                stream >> *value;
+                break;
+            }
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,84 @@
+/* @@@LICENSE
+*
+*      Copyright (c) 2026 LG Electronics, Inc.
+*
+* Licensed under the Apache License, Version 2.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+* http://www.apache.org/licenses/LICENSE-2.0
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+* LICENSE@@@ */
+
+#ifndef MIMSETTINGSSNAPSHOT_H
+#define MIMSETTINGSSNAPSHOT_H
+
+#include <QFile>
+#include <QString>
+#include <QVariant>
+
+class QSettings;
+
+//! \internal
+/*! \ingroup maliitserver
+ * \brief Read-only compiled copy of a settings file.
+ *
+ * The snapshot holds the keys of the settings file sorted, with interned
+ * UTF-16 strings and typed values, and is memory-mapped, so every server
+ * instance shares the same pages. Lookups are a binary search over the
+ * mapping. The settings file stays the source of truth: the snapshot is
+ * stamped with its modification time and size and each rewrite bumps the
+ * generation, so a stale snapshot is detected and recompiled.
+ */
+class MImSettingsSnapshot
+{
+public:
+    MImSettingsSnapshot(const QString &fileName, const QString &sourceFileName);
+    ~MImSettingsSnapshot();
+
+    //! Maps the snapshot file if it matches the source file.
+    bool load();
+    //! Compiles \a settings, which must be synced, into the next generation and maps it.
+    bool write(const QSettings &settings);
+    //! Maps the snapshot again if another process rewrote it or its source.
+    void refresh();
+
+    //! Returns true if lookups can be answered from the snapshot.
+    bool isValid() const;
+    //! Marks the snapshot stale after a change that is not written yet.
+    void invalidate();
+    quint64 generation() const;
+
+    //! Looks up \a key, which must be normalized with normalizedKey().
+    //! Returns false if the snapshot has no value for it.
+    bool value(const QString &key, QVariant *value) const;
+
+    //! Returns \a key the way QSettings stores it, e.g. "/maliit//a/" as "maliit/a".
+    static QString normalizedKey(const QString &key);
+
+private:
+    Q_DISABLE_COPY(MImSettingsSnapshot)
+
+    void unmap();
+    bool isCurrent(quint64 generation) const;
+
+    QString m_fileName;
+    QString m_sourceFileName;
+    QFile m_file;
+    const uchar *m_data;
+    qint64 m_size;
+    quint64 m_generation;
+    // The mapping matches the source file
+    bool m_valid;
+    // Local changes are not written yet
+    bool m_stale;
+};
+//! \internal_end
+
+#endif // MIMSETTINGSSNAPSHOT_H
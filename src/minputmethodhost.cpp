@@ -271,6 +271,12 @@ AbstractPluginSetting *MInputMethodHost::registerPluginSetting(const QString &ke
 
 int MInputMethodHost::instanceId() const
 {
+    // When one process serves several displays, each connection carries its own id
+    const int displayId = connection->displayId();
+    if (displayId >= 0) {
+        return displayId;
+    }
+
     return MImGlobalSettings::instance()->getInstanceId();
 }
 
@@ -58,6 +58,10 @@ SERVER_HEADERS_PRIVATE += \
         mimserveroptions.h \
         windowgroup.h \
         windowdata.h \
+        mimpluginindex.h \
+        mimserversnapshot.h \
+        mimpluginprofiler.h \
+        mimprocessinfo.h \
         abstractplatform.h \
         unknownplatform.h \
 
@@ -74,6 +78,10 @@ SERVER_SOURCES += \
         mimserveroptions.cpp \
         windowgroup.cpp \
         windowdata.cpp \
+        mimpluginindex.cpp \
+        mimserversnapshot.cpp \
+        mimpluginprofiler.cpp \
+        mimprocessinfo.cpp \
         abstractplatform.cpp \
         unknownplatform.cpp \
 
@@ -109,11 +117,13 @@ PKGCONFIG += glib-2.0 luna-service2
 SETTINGS_HEADERS_PRIVATE += \
         mimsettingslunasettings.h \
         mimsettingsqsettings.h \
+        mimsettingssnapshot.h \
         mimsettings.h \
 
 SETTINGS_SOURCES += \
         mimsettings.cpp \
         mimsettingsqsettings.cpp \
+        mimsettingssnapshot.cpp \
         mimsettingslunasettings.cpp \
 
 HEADERS += \
@@ -130,7 +140,7 @@ SOURCES += \
 
 CONFIG += link_pkgconfig
 
-QT = core gui gui-private qml quick
+QT = core gui gui-private qml quick concurrent
 
 # libudev needed by non-contextkit MImHwKeyboardTracker
 PKGCONFIG += libudev
@@ -119,6 +119,26 @@ void WindowGroup::setApplicationWindow(WId id)
     }
 }
 
+void WindowGroup::releaseWindows()
+{
+    Q_FOREACH (const WindowData &data, m_window_list) {
+        if (data.m_window and not data.m_window->parent() and
+            not data.m_window->isVisible()) {
+            data.m_window->destroy();
+        }
+    }
+}
+
+void WindowGroup::restoreWindows()
+{
+    Q_FOREACH (const WindowData &data, m_window_list) {
+        if (data.m_window and not data.m_window->parent() and
+            not data.m_window->handle()) {
+            m_platform->setupInputPanel(data.m_window, data.m_position);
+        }
+    }
+}
+
 void WindowGroup::onVisibleChanged(bool visible)
 {
     if (m_active) {
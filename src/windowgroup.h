@@ -55,6 +55,11 @@ public:
     void setInputMethodArea(const QRegion &region, QWindow *window);
     void setApplicationWindow(WId id);
 
+    //! Destroys the platform resources of hidden top-level windows
+    void releaseWindows();
+    //! Recreates windows released by releaseWindows()
+    void restoreWindows();
+
 Q_SIGNALS:
     void inputMethodAreaChanged(const QRegion &inputMethodArea);
 